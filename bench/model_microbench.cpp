@@ -0,0 +1,175 @@
+// Микробенчмарки горячих путей модели. Карты синтетические: сетка кварталов
+// от нескольких дорог до 100 тысяч, чтобы было видно, как время растёт с размером
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/application.h"
+#include "../src/collision_detector.h"
+#include "../src/json_utils.h"
+#include "../src/loot_generator.h"
+#include "../src/model.h"
+
+using namespace model;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr Coord BLOCK = 10;
+
+// Сетка кварталов со стороной BLOCK из road_count отрезков дорог. На каждый квартал
+// по зданию, на каждую строку кварталов по офису
+Map MakeGridMap(size_t road_count) {
+    const auto side = static_cast<Coord>(std::ceil(std::sqrt(static_cast<double>(road_count) / 2.0)));
+    Map map(Map::Id{"grid" + std::to_string(road_count)}, "Grid", 3);
+
+    size_t added = 0;
+    for (Coord row = 0; row <= side && added < road_count; ++row) {
+        for (Coord col = 0; col < side && added < road_count; ++col) {
+            map.AddRoad(Road{Road::HORIZONTAL, Point{col * BLOCK, row * BLOCK}, (col + 1) * BLOCK});
+            ++added;
+            if (added < road_count && row < side) {
+                map.AddRoad(Road{Road::VERTICAL, Point{col * BLOCK, row * BLOCK}, (row + 1) * BLOCK});
+                ++added;
+            }
+            if (row < side) {
+                map.AddBuilding(Building{Rectangle{Point{col * BLOCK + 1, row * BLOCK + 1}, Size{BLOCK - 2, BLOCK - 2}}});
+            }
+        }
+        map.AddOffice(Office{Office::Id{"o" + std::to_string(row)}, Point{0, row * BLOCK}, Offset{1, 0}});
+    }
+    map.BuildRoadGraph();
+    return map;
+}
+
+Coord GridExtent(const Map& map) {
+    Coord extent = 0;
+    for (const auto& road : map.GetRoads()) {
+        extent = std::max({extent, road.GetStart().x, road.GetEnd().x, road.GetStart().y, road.GetEnd().y});
+    }
+    return extent;
+}
+
+std::vector<Position> RandomPositions(size_t count, double extent, uint64_t seed) {
+    util::Xoshiro256 random{seed};
+    std::vector<Position> positions(count);
+    for (auto& position : positions) {
+        position = {random.NextDouble() * extent, random.NextDouble() * extent};
+    }
+    return positions;
+}
+
+}  // namespace
+
+TEST_CASE("Map::IsOnRoad", "[!benchmark][Roads]") {
+    const size_t roads = GENERATE(16, 1024, 100'000);
+    const Map map = MakeGridMap(roads);
+    // Половина точек на дорогах, половина внутри кварталов
+    auto points = RandomPositions(1024, GridExtent(map), 1);
+    for (size_t i = 0; i < points.size(); i += 2) {
+        points[i].y = std::round(points[i].y / BLOCK) * BLOCK;
+    }
+
+    BENCHMARK("IsOnRoad x1024, roads " + std::to_string(roads)) {
+        size_t on_road = 0;
+        for (const auto& point : points) {
+            on_road += map.IsOnRoad(point);
+        }
+        return on_road;
+    };
+}
+
+TEST_CASE("MoveDogsScenario::MoveDog", "[!benchmark][Roads]") {
+    const size_t roads = GENERATE(16, 1024, 100'000);
+    const auto map = std::make_shared<Map>(MakeGridMap(roads));
+    const double extent = GridExtent(*map);
+
+    DogStore dogs;
+    util::Xoshiro256 random{2};
+    constexpr size_t DOG_COUNT = 1024;
+    for (uint32_t i = 0; i < DOG_COUNT; ++i) {
+        // Собаки на горизонтальных дорогах, бегут на восток
+        const Position position{random.NextDouble() * extent, std::floor(random.NextDouble() * extent / BLOCK) * BLOCK};
+        dogs.Add(Dog("dog", i, 3, position, Velocity{3.0, 0.0}, Direction::EAST));
+    }
+    std::vector<Position> start(dogs.GetPositions().begin(), dogs.GetPositions().end());
+
+    BENCHMARK_ADVANCED("MoveDog x1024, roads " + std::to_string(roads))(Catch::Benchmark::Chronometer meter) {
+        for (size_t i = 0; i < DOG_COUNT; ++i) {
+            DogRef dog(dogs, i);
+            dog.SetPosition(start[i]);
+            dog.SetVelocity({3.0, 0.0});
+        }
+        meter.measure([&] {
+            for (size_t i = 0; i < DOG_COUNT; ++i) {
+                app::MoveDogsScenario::MoveDog(DogRef(dogs, i), map, 0.05);
+            }
+        });
+    };
+}
+
+TEST_CASE("collision_detector::FindGatherEvents", "[!benchmark][Collisions]") {
+    const auto [item_count, gatherer_count] = GENERATE(table<size_t, size_t>({
+        {10, 10},
+        {1'000, 100},
+        {10'000, 1'000},
+        {100'000, 10'000},
+    }));
+    // Плотность как на обычной карте: около одного предмета на квартал
+    const double extent = std::sqrt(static_cast<double>(item_count)) * BLOCK;
+    util::Xoshiro256 random{3};
+
+    std::vector<collision_detector::Item> items(item_count);
+    for (size_t i = 0; i < item_count; ++i) {
+        items[i] = {{random.NextDouble() * extent, random.NextDouble() * extent}, 0.0, static_cast<int>(i)};
+    }
+    std::vector<collision_detector::Gatherer> gatherers(gatherer_count);
+    for (size_t i = 0; i < gatherer_count; ++i) {
+        const geom::Point2D start{random.NextDouble() * extent, random.NextDouble() * extent};
+        gatherers[i] = {start, {start.x + 0.15, start.y}, 0.6, static_cast<int>(i)};
+    }
+
+    std::pmr::unsynchronized_pool_resource resource;
+    std::pmr::vector<collision_detector::GatheringEvent> events(&resource);
+    BENCHMARK("items " + std::to_string(item_count) + ", gatherers " + std::to_string(gatherer_count)) {
+        collision_detector::FindGatherEvents(items, gatherers, events);
+        return events.size();
+    };
+}
+
+TEST_CASE("LootGenerator::Generate", "[!benchmark][Loots]") {
+    loot_gen::LootGenerator generator{5s, 0.5};
+    BENCHMARK("Generate x1024") {
+        unsigned total = 0;
+        for (unsigned i = 0; i < 1024; ++i) {
+            total += generator.Generate(50ms, i % 16, 16);
+        }
+        return total;
+    };
+}
+
+TEST_CASE("PositionHasher", "[!benchmark][Roads]") {
+    const auto positions = RandomPositions(1024, 1000.0, 4);
+    const PositionHasher hasher;
+    BENCHMARK("hash x1024") {
+        size_t combined = 0;
+        for (const auto& position : positions) {
+            combined ^= hasher(position);
+        }
+        return combined;
+    };
+}
+
+TEST_CASE("json_utils::MapToJson", "[!benchmark][Json]") {
+    const size_t roads = GENERATE(16, 1024, 100'000);
+    const Map map = MakeGridMap(roads);
+    BENCHMARK("MapToJson, roads " + std::to_string(roads)) {
+        return json_utils::MapToJson(map);
+    };
+}
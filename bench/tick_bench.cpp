@@ -0,0 +1,177 @@
+// Нагрузочный прогон Application::Tick без сервера и базы данных.
+// Загружает конфигурацию, заводит синтетических собак, двигает их по сценарию
+// и меряет длительность тиков
+#include <boost/asio/thread_pool.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/application.h"
+#include "../src/json_loader.h"
+#include "../src/records.h"
+
+namespace {
+
+using namespace std::literals;
+using Clock = std::chrono::steady_clock;
+
+struct Args {
+    std::filesystem::path config_file = "data/config.json";
+    unsigned dogs = 1000;
+    unsigned maps = 0;
+    unsigned ticks = 1000;
+    int tick_delta = 50;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned action_period = 20;
+    uint64_t seed = 42;
+};
+
+[[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description desc{"All options"s};
+
+    Args args;
+    desc.add_options()
+        ("help,h", "Show help")
+        ("config-file,c", po::value(&args.config_file)->value_name("file"), "set config file path")
+        ("dogs,n", po::value(&args.dogs)->value_name("count"), "number of synthetic dogs")
+        ("maps,m", po::value(&args.maps)->value_name("count"), "spread dogs over the first maps of the config, 0 for all")
+        ("ticks,t", po::value(&args.ticks)->value_name("count"), "number of measured ticks")
+        ("tick-delta,d", po::value(&args.tick_delta)->value_name("milliseconds"), "game time of one tick")
+        ("threads,j", po::value(&args.threads)->value_name("count"), "threads that tick sessions")
+        ("action-period", po::value(&args.action_period)->value_name("ticks"), "ticks between direction changes of a dog")
+        ("seed", po::value(&args.seed)->value_name("number"), "seed of spawning and loot");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.contains("help"s)) {
+        std::cout << desc;
+        return std::nullopt;
+    }
+    if (args.dogs == 0 || args.ticks == 0 || args.tick_delta <= 0 || args.threads == 0 || args.action_period == 0) {
+        throw po::error("dogs, ticks, tick delta, threads and action period must be positive");
+    }
+    return args;
+}
+
+// Направление, которое сценарий задаёт игроку player на шаге step. Раз в несколько
+// смен собака останавливается, чтобы часть игроков доживала до пенсии
+std::optional<model::Direction> ScriptedDirection(size_t player, size_t step) {
+    const size_t choice = (player * 7 + step) % 5;
+    if (choice == 4) {
+        return std::nullopt;
+    }
+    static constexpr model::Direction DIRECTIONS[] = {
+        model::Direction::NORTH, model::Direction::EAST, model::Direction::SOUTH, model::Direction::WEST};
+    return DIRECTIONS[choice];
+}
+
+double Percentile(const std::vector<double>& sorted, double p) {
+    const auto rank = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+    try {
+        auto args = ParseCommandLine(argc, argv);
+        if (!args) {
+            return EXIT_SUCCESS;
+        }
+
+        ExtraData ex_data;
+        double dog_retirement_time = 0.0;
+        model::Game game = json_loader::LoadGame(args->config_file, true, ex_data, dog_retirement_time);
+        game.SetRandomSeed(args->seed);
+
+        InMemoryRecords records;
+        app::Application app(game, ex_data, records, dog_retirement_time);
+
+        boost::asio::thread_pool pool(args->threads);
+        app.SetTickExecutor({pool.get_executor(), args->threads});
+
+        const auto& maps = game.GetMaps();
+        const size_t map_count = args->maps == 0 ? maps.size() : std::min<size_t>(args->maps, maps.size());
+        if (map_count == 0) {
+            throw std::runtime_error("Config has no maps");
+        }
+
+        auto join = app.GetJoinGameScenario();
+        std::vector<players::Token> tokens;
+        tokens.reserve(args->dogs);
+        for (unsigned i = 0; i < args->dogs; ++i) {
+            const auto& map_id = *maps[i % map_count].GetId();
+            auto result = join->Execute("dog" + std::to_string(i), map_id);
+            if (!result) {
+                throw std::runtime_error("Failed to join map " + map_id);
+            }
+            tokens.push_back(result->token);
+        }
+
+        size_t sessions = 0;
+        for (const auto& [id, instances] : game.GetSessions()) {
+            sessions += instances.size();
+        }
+
+        auto action = app.GetActionGameScenario();
+        const std::chrono::milliseconds delta{args->tick_delta};
+        std::vector<double> latencies_us;
+        latencies_us.reserve(args->ticks);
+        size_t dog_updates = 0;
+
+        const auto start = Clock::now();
+        for (unsigned tick = 0; tick < args->ticks; ++tick) {
+            // Действия игроков приходят между тиками и в замер не входят
+            for (size_t i = 0; i < tokens.size(); ++i) {
+                if ((tick + i) % args->action_period == 0) {
+                    action->Execute(tokens[i], ScriptedDirection(i, tick / args->action_period));
+                }
+            }
+
+            dog_updates += app.GetPlayers().GetPlayers().size();
+            const auto tick_start = Clock::now();
+            app.Tick(delta);
+            const auto tick_end = Clock::now();
+            latencies_us.push_back(std::chrono::duration<double, std::micro>(tick_end - tick_start).count());
+        }
+        const auto total = Clock::now() - start;
+
+        std::vector<double> sorted = latencies_us;
+        std::sort(sorted.begin(), sorted.end());
+        double tick_time_us = 0.0;
+        for (double latency : latencies_us) {
+            tick_time_us += latency;
+        }
+        const double tick_time_sec = tick_time_us / 1e6;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "maps: " << map_count << ", sessions: " << sessions << ", dogs: " << args->dogs
+                  << ", threads: " << args->threads << ", ticks: " << args->ticks << '\n'
+                  << "tick latency, us: p50 " << Percentile(sorted, 0.50)
+                  << ", p90 " << Percentile(sorted, 0.90)
+                  << ", p99 " << Percentile(sorted, 0.99)
+                  << ", max " << sorted.back() << '\n'
+                  << "throughput: " << args->ticks / tick_time_sec << " ticks/s, "
+                  << dog_updates / tick_time_sec << " dog updates/s\n"
+                  << "wall time with actions: " << std::chrono::duration<double>(total).count() << " s\n"
+                  << "retired: " << records.Size() << ", still playing: " << app.GetPlayers().GetPlayers().size() << '\n';
+
+        pool.join();
+        return EXIT_SUCCESS;
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
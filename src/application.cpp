@@ -1,16 +1,77 @@
 #include "application.h"
+#include "parallel_for.h"
+
+#include <cassert>
 
-#include <unordered_set>
 
 namespace players {
 
+    namespace {
+
+    int HexDigitValue(char c) noexcept {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    bool ParseHalf(std::string_view text, uint64_t& value) noexcept {
+        value = 0;
+        for (char c : text) {
+            int digit = HexDigitValue(c);
+            if (digit < 0) {
+                return false;
+            }
+            value = (value << 4) | static_cast<uint64_t>(digit);
+        }
+        return true;
+    }
+
+    void FormatHalf(uint64_t value, char* out) noexcept {
+        static constexpr char DIGITS[] = "0123456789abcdef";
+        for (int i = 15; i >= 0; --i) {
+            out[i] = DIGITS[value & 0xF];
+            value >>= 4;
+        }
+    }
+
+    } // namespace
+
+    std::optional<Token> Token::Parse(std::string_view text) noexcept {
+        if (text.size() != STRING_LENGTH) {
+            return std::nullopt;
+        }
+        Token token;
+        if (!ParseHalf(text.substr(0, 16), token.high) || !ParseHalf(text.substr(16), token.low)) {
+            return std::nullopt;
+        }
+        return token;
+    }
+
+    std::string Token::ToString() const {
+        std::string result(STRING_LENGTH, '0');
+        FormatHalf(high, result.data());
+        FormatHalf(low, result.data() + 16);
+        return result;
+    }
+
     Token PlayerTokens::AddPlayerToken(std::shared_ptr<Player> player) {
         Token token = GenerateToken();
+        // Повтор 128-битного токена практически невозможен, но выдать чужой нельзя
+        while (tokens_.contains(token)) {
+            token = GenerateToken();
+        }
         tokens_[token] = player;
         return token;
     }
 
-    std::shared_ptr<Player> PlayerTokens::GetPlayerByToken(const Token& token) {
+    std::shared_ptr<Player> PlayerTokens::GetPlayerByToken(const Token& token) const {
         auto it = tokens_.find(token);
         return it != tokens_.end() ? it->second : nullptr;
     }
@@ -20,47 +81,53 @@ namespace players {
     }
 
     Token PlayerTokens::GenerateToken() {
-        std::uniform_int_distribution<uint64_t> dist;
-        uint64_t part1 = dist(generator1_);
-        uint64_t part2 = dist(generator2_);
-        
-        std::stringstream ss;
-        ss << std::hex << part1 << part2;
-        std::string token = ss.str();
-
-        if (token.length() < 32) {
-            token.insert(0, 32 - token.length(), '0');
-        } else if (token.length() > 32) {
-            token = token.substr(0, 32);
-        }
-
-        return token;
+        // mt19937_64 и так выдаёт все 64 бита, распределение не нужно и зависело бы от реализации
+        return Token{generator1_(), generator2_()};
     }
 
-    std::shared_ptr<Player> Players::AddPlayer(std::shared_ptr<model::Dog> dog, std::shared_ptr<model::GameSession> session) {
+    std::shared_ptr<Player> Players::AddPlayer(model::DogHandle dog, std::shared_ptr<model::GameSession> session) {
         auto player = std::make_shared<Player>(dog, session, next_id_player_++);
         Token auth_token = tokens_->AddPlayerToken(player);
         player->AddToken(auth_token);
-        players_.push_back(player);
-        return player;
+        Index(std::move(player));
+        return players_.back();
     }
 
-    std::shared_ptr<Player> Players::GetPlayerById(uint32_t dog_id, const std::string& map_id) {
-        for (const auto& player : players_) {
-            if (player->GetPlayerDogId() == dog_id && *player->GetSession()->GetMap()->GetId() == map_id) {
-                return player;
-            }
-        }
-        return nullptr;
+    void Players::RestorePlayer(std::shared_ptr<Player> player) {
+        tokens_->AddPlayerWithToken(player, player->GetToken());
+        Index(std::move(player));
+    }
+
+    void Players::Index(std::shared_ptr<Player> player) {
+        index_by_dog_[KeyOf(*player)] = players_.size();
+        players_.push_back(std::move(player));
     }
 
-    std::shared_ptr<Player> Players::GetPlayerByToken(const Token& token) {
+    std::shared_ptr<Player> Players::GetPlayerById(uint32_t dog_id, const model::GameSession& session) const {
+        auto it = index_by_dog_.find(DogKey{&session, dog_id});
+        return it != index_by_dog_.end() ? players_[it->second] : nullptr;
+    }
+
+    std::shared_ptr<Player> Players::GetPlayerByToken(const Token& token) const {
         return tokens_->GetPlayerByToken(token);
     }
 
-    void Players::RemovePlayer(std::shared_ptr<Player> player) {
-        tokens_->RemovePlayerToken(player->GetToken());
-        players_.erase(std::remove(players_.begin(), players_.end(), player), players_.end());
+    void Players::RemovePlayer(const std::shared_ptr<Player>& player) {
+        auto it = index_by_dog_.find(KeyOf(*player));
+        if (it == index_by_dog_.end() || players_[it->second] != player) {
+            return;
+        }
+        // Держим ссылку: player может указывать на элемент players_
+        auto removed = player;
+        const size_t index = it->second;
+        index_by_dog_.erase(it);
+        tokens_->RemovePlayerToken(removed->GetToken());
+
+        if (index + 1 != players_.size()) {
+            players_[index] = std::move(players_.back());
+            index_by_dog_[KeyOf(*players_[index])] = index;
+        }
+        players_.pop_back();
     }
 
 }
@@ -81,10 +148,6 @@ namespace app {
 
         auto bag_capacity = game_.GetDefaultBagCapacity(model::Map::Id{map_id});
         auto new_dog = session->AddDog(user_name, bag_capacity);
-        if (!new_dog ) {
-            std::cerr << "Error: не создалась собака!" << std::endl;
-        }
-
         auto player = players_.AddPlayer(new_dog, session);
 
         return Result{player->GetId(), player->GetToken()};
@@ -100,90 +163,57 @@ namespace app {
             std::cerr << "Error: player has no active session!" << std::endl;
             return false;
         }
+        auto dog = player->GetDog();
+        if (!dog) {
+            return false;
+        }
         auto id_map = session->GetMap()->GetId();
         auto speed = game_.GetDefaultDogSpeed(id_map);
 
         if (!direction) {
-            player->GetDog()->SetVelocity({0.0, 0.0});
+            dog->SetVelocity({0.0, 0.0});
         } else {
             switch (direction.value()) {
                 case model::Direction::WEST: 
-                    player->GetDog()->SetDirection(model::Direction::WEST);
-                    player->GetDog()->SetVelocity({-speed, 0.0});
+                    dog->SetDirection(model::Direction::WEST);
+                    dog->SetVelocity({-speed, 0.0});
                     break;
                 case model::Direction::EAST:
-                    player->GetDog()->SetDirection(model::Direction::EAST);
-                    player->GetDog()->SetVelocity({speed, 0.0});
+                    dog->SetDirection(model::Direction::EAST);
+                    dog->SetVelocity({speed, 0.0});
                     break;
                 case model::Direction::NORTH: 
-                    player->GetDog()->SetDirection(model::Direction::NORTH);
-                    player->GetDog()->SetVelocity({0.0, -speed});
+                    dog->SetDirection(model::Direction::NORTH);
+                    dog->SetVelocity({0.0, -speed});
                     break;
                 case model::Direction::SOUTH: 
-                    player->GetDog()->SetDirection(model::Direction::SOUTH);
-                    player->GetDog()->SetVelocity({0.0, speed});
+                    dog->SetDirection(model::Direction::SOUTH);
+                    dog->SetVelocity({0.0, speed});
                     break;
             }
         }
-        player->GetDog()->UpdateTimes(0);
+        dog->UpdateTimes(0);
+        session->MarkChanged();
         return true;
     }
 
-    std::vector<PlayersScenario::PlayerData> PlayersScenario::Execute(const players::Token& token) {
+    std::optional<PlayersScenario::Result> PlayersScenario::Execute(const players::Token& token) {
         auto player = players_.GetPlayerByToken(token);
         if (!player) {
-            return {};
+            return std::nullopt;
         }
-        auto session = player->GetSession();
-        auto dogs = session->GetDogs();
-        std::vector<PlayerData> result;
-        result.reserve(dogs.size());
-
-        std::transform(dogs.begin(), dogs.end(), std::back_inserter(result),
-            [](const auto& pair) {
-                const auto& [id, dog] = pair;
-                return PlayerData{id, dog->GetName()};
-            });
-        return result;
+        const auto& session = *player->GetSession();
+        const auto& dogs = session.GetDogs();
+        return Result{session, dogs.GetIds(), dogs.GetNames()};
     }
 
-    std::pair<std::vector<GameStateScenario::PlayerData>, std::vector<GameStateScenario::LootData>> GameStateScenario::Execute(const players::Token& token) {
+    std::optional<GameStateScenario::Result> GameStateScenario::Execute(const players::Token& token) {
         auto player = players_.GetPlayerByToken(token);
         if (!player) {
-            return {{},{}};
+            return std::nullopt;
         }
-        auto session = player->GetSession();
-        auto dogs = session->GetDogs();
-        std::vector<PlayerData> players_data;
-        players_data.reserve(dogs.size());
-
-        std::transform(dogs.begin(), dogs.end(), std::back_inserter(players_data),
-            [](const auto& pair) {
-                const auto& [id, dog] = pair;
-                return PlayerData{
-                    id,
-                    dog->GetPosition(),
-                    dog->GetVelocity(),
-                    dog->GetDirection(),
-                    dog->GetBag().GetItems(),
-                    dog->GetPoints()
-                };
-            });
-
-        auto loots = session->GetLoots();
-        std::vector<LootData> loots_data;
-        loots_data.reserve(loots.size());
-
-        std::transform(loots.begin(), loots.end(), std::back_inserter(loots_data),
-            [](const auto& pair) {
-                const auto& [id, loot] = pair;
-                return LootData{
-                    id,
-                    loot->GetType(),
-                    loot->GetPosition()
-                };
-            });
-        return {players_data, loots_data};
+        const auto& session = player->GetSession();
+        return Result{*session, session->GetDogs(), session->GetLoots().GetValues()};
     }
 
     std::vector<MapsScenario::MapData> MapsScenario::Execute() {
@@ -200,186 +230,165 @@ namespace app {
     }
 
     void MoveDogsScenario::Execute(std::chrono::milliseconds delta) {
-        double delta_time_sec = static_cast<double>(delta.count()) / 1000.0;
-        int64_t delta_ms = delta.count();
-        
-        auto sessions = game_.GetSessions();
-        for (const auto& [id_map, session] : sessions) {
-            auto dogs = session->GetDogs();
-            auto loots_gener = game_.GetLootGenerator();
-            int num_loots = loots_gener->Generate(delta, session->GetNumLoots(), dogs.size());
-            session->AddLoots(num_loots);
-
-            auto loots = session->GetLoots();
-            auto offices = session->GetMap()->GetOffices();
-
-            std::vector<collision_detector::Item> items;
-            items.reserve(loots.size() + offices.size());
-
-            std::transform(loots.begin(), loots.end(), std::back_inserter(items),
-                [](const auto& pair) {
-                    const auto& [id, loot] = pair;
-                    return collision_detector::Item{
-                        {loot->GetPosition().x, loot->GetPosition().y},
-                        WIDTH_LOOT / 2,
-                        id + 1
-                    };
-                });
-
-            std::transform(offices.begin(), offices.end(), std::back_inserter(items),
-                [](const auto& office) {
-                    return collision_detector::Item{
-                        {static_cast<double>(office.GetPosition().x), static_cast<double>(office.GetPosition().y)},
-                        WIDTH_OFFICE / 2,
-                        0
-                    };
-                });
-
-            std::vector<collision_detector::Gatherer> gatherers;
-            gatherers.reserve(dogs.size());
-
-            std::unordered_set<uint32_t> standing_dogs;
-
-            for (auto& [id, dog] : dogs) {
-                auto map = session->GetMap();
-                collision_detector::Gatherer gatherer;
-                gatherer.start_pos = {dog->GetPosition().x, dog->GetPosition().y};
-                auto prev_velocity = dog->GetVelocity();
-                auto end_pos = MoveDog(*dog, map, delta_time_sec);
-                gatherer.end_pos = {end_pos.x, end_pos.y};
-                gatherer.width = WIDTH_PLAYER / 2;
-                gatherer.id = id;
-                gatherers.push_back(gatherer);
-
-                if (prev_velocity.IsZero() && dog->GetVelocity().IsZero()) {
-                    standing_dogs.insert(id);
+        arenas_.main.Run([&](std::pmr::memory_resource* resource) {
+            std::pmr::vector<model::GameSession*> sessions(resource);
+
+            // Генератор трофеев общий для всех карт, поэтому трофеи появляются до параллельной части
+            const auto& loots_gener = game_.GetLootGenerator();
+            for (const auto& [id_map, instances] : game_.GetSessions()) {
+                for (const auto& session : instances) {
+                    int num_loots = loots_gener->Generate(delta, session->GetNumLoots(), session->GetDogs().Size());
+                    session->AddLoots(num_loots);
+                    sessions.push_back(session.get());
                 }
             }
-
-            collision_detector::Provider provider(items, gatherers);
-            auto events = collision_detector::FindGatherEvents(provider);
-            std::unordered_set<size_t> collected_loot_ids;
-
-            for (const auto& event : events) {
-                auto dog = dogs.at(event.gatherer_id);
-                if (event.item_id == 0) {
-                    auto loots_in_bag = dog->GetBag().GetItems();
-                    int points = 0;
-                    for (auto& [id, type] : loots_in_bag) {
-                        points += ex_data_.GetValueLoot(*id_map, type);
-                    }
-                    dog->AddPoints(points);
-                    dog->GetBag().Clear();
-                } else if (collected_loot_ids.count(event.item_id) == 0) {
-                    auto loot = loots.at(event.item_id - 1);
-                    if (!dog->GetBag().IsFull()) {
-                        dog->GetBag().AddItem(event.item_id - 1, loot->GetType());
-                        session->RemoveLoot(event.item_id - 1);
-                        collected_loot_ids.insert(event.item_id);
-                    }
-                }
+            if (arenas_.sessions.size() < sessions.size()) {
+                arenas_.sessions.resize(sessions.size());
             }
-            for (auto it = dogs.begin(); it != dogs.end();) {
-                auto& [id, dog] = *it;
 
-                if(standing_dogs.count(id)) {
-                    dog->AddInactiveTime(delta_ms);
-                } else {
-                    dog->UpdateTimes(delta_ms);
+            std::pmr::vector<std::vector<Retirement>> retirements(sessions.size(), resource);
+            auto tick_session = [&](size_t i) {
+                arenas_.sessions[i].Run([&](std::pmr::memory_resource* session_resource) {
+                    retirements[i] = TickSession(*sessions[i], delta, session_resource);
+                });
+            };
+            if (executor_) {
+                util::ParallelFor(arenas_.parallel_for, executor_->executor, executor_->concurrency, sessions.size(), tick_session);
+            } else {
+                for (size_t i = 0; i < sessions.size(); ++i) {
+                    tick_session(i);
                 }
+            }
 
-                if (dog->GetInactiveTimeMs() >= dog_retirement_time_ * 1000) {
-                    auto player = players_.GetPlayerById(id, *session->GetMap()->GetId());
+            // Игроки и база общие для всех сессий, поэтому собак отправляем на пенсию уже после объединения
+            for (size_t i = 0; i < sessions.size(); ++i) {
+                for (const auto& retirement : retirements[i]) {
+                    auto player = players_.GetPlayerById(retirement.dog.id, *sessions[i]);
                     if (player) {
-                        db_handler_.SaveRetiredPlayer({
-                            dog->GetName(),
-                            dog->GetPoints(),
-                            dog->GetJoinTimeMs()
-                        });
+                        records_.SaveRetiredPlayer(retirement.record);
                         players_.RemovePlayer(player);
-                        session->RemoveDog(id);
-                        continue;
+                        sessions[i]->RemoveDog(retirement.dog);
                     }
                 }
-                ++it;            
             }
-        }
+        });
     }
 
-    model::Position MoveDogsScenario::MoveDog(model::Dog& dog, const std::shared_ptr<model::Map>& map, double delta_time) {
-        constexpr int BINARY_SEARCH_ITERATIONS = 15;
+    std::vector<MoveDogsScenario::Retirement> MoveDogsScenario::TickSession(model::GameSession& session, std::chrono::milliseconds delta,
+                                                                            std::pmr::memory_resource* resource) const {
+        double delta_time_sec = static_cast<double>(delta.count()) / 1000.0;
+        int64_t delta_ms = delta.count();
+        const auto& id_map = *session.GetMap()->GetId();
+        auto& dogs = session.GetDogs();
+        // Собаки двигаются и стареют через DogRef, сессия об этом не знает
+        session.MarkChanged();
+
+        // Предмет i + 1 — трофей в позиции i плотного массива, 0 — офис.
+        // Ключи запоминаются заранее: удаление трофея переставляет плотный массив
+        const auto& loots = session.GetLoots();
+        const std::pmr::vector<model::GameSession::LootKey> loot_keys(loots.GetKeys().begin(), loots.GetKeys().end(), resource);
+        const auto& offices = session.GetMap()->GetOffices();
+
+        std::pmr::vector<collision_detector::Item> items(resource);
+        items.reserve(loots.Size() + offices.size());
+
+        const auto loot_values = loots.GetValues();
+        for (size_t i = 0; i < loot_values.size(); ++i) {
+            items.push_back(collision_detector::Item{
+                {loot_values[i].GetPosition().x, loot_values[i].GetPosition().y},
+                WIDTH_LOOT / 2,
+                static_cast<int>(i + 1)
+            });
+        }
 
-        if (dog.GetVelocity().IsZero()) return dog.GetPosition();
+        std::transform(offices.begin(), offices.end(), std::back_inserter(items),
+            [](const auto& office) {
+                return collision_detector::Item{
+                    {static_cast<double>(office.GetPosition().x), static_cast<double>(office.GetPosition().y)},
+                    WIDTH_OFFICE / 2,
+                    0
+                };
+            });
 
-        const double speed_x = dog.GetVelocity().dx;
-        const double speed_y = dog.GetVelocity().dy;
-        const double move_x = speed_x * delta_time;
-        const double move_y = speed_y * delta_time;
-
-        auto findBoundary = [&map](model::Position start, model::Position end) -> model::Position {
-            const int steps = 100;
-            model::Position current = start;
-            model::Position last_valid = start;
-
-            for (int i = 0; i <= steps; ++i) {
-                double ratio = static_cast<double>(i) / steps;
-                current.x = start.x + (end.x - start.x) * ratio;
-                current.y = start.y + (end.y - start.y) * ratio;
-
-                if (map->IsOnRoad(current)) {
-                    last_valid = current;
-                } else {
-                    model::Position low = last_valid;
-                    model::Position high = current;
-                    for (int j = 0; j < BINARY_SEARCH_ITERATIONS; ++j) {
-                        model::Position mid {
-                            (low.x + high.x) / 2,
-                            (low.y + high.y) / 2
-                        };
-                        if (map->IsOnRoad(mid)) {
-                            low = mid;
-                        } else {
-                            high = mid;
-                        }
-                    }
-                    if (std::abs(start.x - end.x) > std::abs(start.y - end.y)) {
-                        low.x = std::round(low.x * 10) / 10;
-                    } else {
-                        low.y = std::round(low.y * 10) / 10;
-                    }
-                    return low;
+        // Собиратель i — собака с индексом i в хранилище сессии
+        std::pmr::vector<collision_detector::Gatherer> gatherers(resource);
+        gatherers.reserve(dogs.Size());
+
+        std::pmr::vector<bool> standing_dogs(dogs.Size(), false, resource);
+        const auto& map = session.GetMap();
+
+        for (size_t i = 0; i < dogs.Size(); ++i) {
+            collision_detector::Gatherer gatherer;
+            gatherer.start_pos = {dogs.GetPositions()[i].x, dogs.GetPositions()[i].y};
+            auto prev_velocity = dogs.GetVelocities()[i];
+            auto end_pos = MoveDog(model::DogRef(dogs, i), map, delta_time_sec);
+            gatherer.end_pos = {end_pos.x, end_pos.y};
+            gatherer.width = WIDTH_PLAYER / 2;
+            gatherer.id = static_cast<int>(i);
+            gatherers.push_back(gatherer);
+
+            standing_dogs[i] = prev_velocity.IsZero() && dogs.GetVelocities()[i].IsZero();
+        }
+
+        std::pmr::vector<collision_detector::GatheringEvent> events(resource);
+        collision_detector::FindGatherEvents(items, gatherers, events);
+
+        for (const auto& event : events) {
+            auto& bag = dogs.GetBags()[event.gatherer_id];
+            if (event.item_id == 0) {
+                int points = 0;
+                for (const auto& item : bag.GetItems()) {
+                    points += ex_data_.GetValueLoot(id_map, item.type);
+                }
+                dogs.GetPoints()[event.gatherer_id] += points;
+                bag.Clear();
+                dogs.MarkChanged(event.gatherer_id);
+            } else if (const auto key = loot_keys[event.item_id - 1]; !bag.IsFull()) {
+                // Трофей, уже подобранный раньше в этом тике, не найдётся по устаревшему ключу
+                if (const model::Loot* loot = loots.Find(key)) {
+                    bag.AddItem(loot->GetId(), loot->GetType());
+                    dogs.MarkChanged(event.gatherer_id);
+                    session.RemoveLoot(key);
                 }
             }
-            return last_valid;
-        };
-        model::Position new_pos = {
-            dog.GetPosition().x + move_x,
-            dog.GetPosition().y + move_y
-        };
+        }
 
-        model::Position final_pos;
+        std::vector<Retirement> retirements;
+        for (size_t i = 0; i < dogs.Size(); ++i) {
+            model::DogRef dog(dogs, i);
 
-        if (map->IsOnRoad(new_pos)) {
-            dog.SetPosition(new_pos);
-            final_pos = new_pos;
-        } else {
-            model::Position boundary = findBoundary(dog.GetPosition(), new_pos);
-            if (speed_x > 0) {
-                boundary.x = std::floor(boundary.x * 10 + 0.5) / 10;
-            } else if (speed_x < 0) {
-                boundary.x = std::ceil(boundary.x * 10 - 0.5) / 10;
+            if (standing_dogs[i]) {
+                dog.AddInactiveTime(delta_ms);
+            } else {
+                dog.UpdateTimes(delta_ms);
             }
 
-            if (speed_y > 0) {
-                boundary.y = std::floor(boundary.y * 10 + 0.5) / 10;
-            } else if (speed_y < 0) {
-                boundary.y = std::ceil(boundary.y * 10 - 0.5) / 10;
+            if (dog.GetInactiveTimeMs() >= dog_retirement_time_ * 1000) {
+                retirements.push_back(Retirement{
+                    model::DogHandle{dog.GetId()},
+                    {dog.GetName(), dog.GetPoints(), dog.GetJoinTimeMs()}
+                });
             }
+        }
+        session.FinishTick();
+        return retirements;
+    }
+
+    model::Position MoveDogsScenario::MoveDog(model::DogRef dog, const std::shared_ptr<model::Map>& map, double delta_time) {
+        if (dog.GetVelocity().IsZero()) return dog.GetPosition();
 
-            dog.SetPosition(boundary);
+        const model::Position start = dog.GetPosition();
+        const model::Position target = {
+            start.x + dog.GetVelocity().dx * delta_time,
+            start.y + dog.GetVelocity().dy * delta_time
+        };
+
+        // Упираемся в край дороги — останавливаемся на нём
+        const model::Position final_pos = map->MoveAlongRoads(start, target);
+        if (final_pos.x != target.x || final_pos.y != target.y) {
             dog.SetVelocity({0.0, 0.0});
-            final_pos = boundary;
         }
+        dog.SetPosition(final_pos);
 
         return final_pos;
     }
@@ -388,7 +397,7 @@ namespace app {
         if (max_items > 100) {
             throw std::invalid_argument("maxItems exceeds maximum allowed value of 100");
         }
-        return db_handler_.GetRecords(start, max_items);
+        return records_.GetRecords(start, max_items);
     }
 
     std::shared_ptr<JoinGameScenario> Application::GetJoinGameScenario() {
@@ -408,7 +417,8 @@ namespace app {
     }
 
     std::shared_ptr<MoveDogsScenario> Application::GetMoveDogsScenario() {
-        return std::make_shared<MoveDogsScenario>(game_, ex_data_, players_, db_handler_, dog_retirement_time_);
+        return std::make_shared<MoveDogsScenario>(game_, ex_data_, players_, records_, dog_retirement_time_, tick_arenas_,
+                                                  tick_executor_ ? &*tick_executor_ : nullptr);
     }
 
     std::shared_ptr<MapsScenario> Application::GetMapsScenario() {
@@ -418,15 +428,43 @@ namespace app {
         return std::make_shared<MapByIdScenario>(game_);
     }
     std::shared_ptr<RecordsScenario> Application::GetRecordsScenario() {
-        return std::make_shared<RecordsScenario>(db_handler_);
+        return std::make_shared<RecordsScenario>(records_);
     }
 
-    void Application::Tick(std::chrono::milliseconds delta) {
-        auto scenario = GetMoveDogsScenario();
-        scenario->Execute(delta);
+    std::shared_ptr<model::GameSession> Application::FindPlayerSession(const players::Token& token) {
+        auto player = players_.GetPlayerByToken(token);
+        return player ? player->GetSession() : nullptr;
+    }
+
+    void Application::Tick(std::chrono::milliseconds delta, [[maybe_unused]] const SessionsGate::Pass& pass) {
+        assert(pass.IsExclusive());
+        MoveDogsScenario scenario(game_, ex_data_, players_, records_, dog_retirement_time_, tick_arenas_,
+                                  tick_executor_ ? &*tick_executor_ : nullptr);
+        scenario.Execute(delta);
         for (auto& listener : listeners_) {
             listener->OnTick(delta);
         }
     }
 
+    void Application::Tick(std::chrono::milliseconds delta) {
+        if (auto pass = sessions_gate_.LockExclusive()) {
+            Tick(delta, pass);
+        }
+    }
+
+    void Application::AsyncTick(boost::asio::any_io_executor executor, std::chrono::milliseconds delta,
+                                std::function<void(std::exception_ptr)> done) {
+        sessions_gate_.AsyncExclusive(executor, [this, delta, done = std::move(done)](SessionsGate::Pass pass) {
+            std::exception_ptr error;
+            try {
+                Tick(delta, pass);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // Доступ возвращается до done: следующий тик может встать в очередь сразу
+            pass.Release();
+            done(error);
+        });
+    }
+
 }
\ No newline at end of file
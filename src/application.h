@@ -10,11 +10,22 @@
 #include <optional>
 #include <vector>
 #include <chrono> 
+#include <memory_resource>
+#include <exception>
+#include <functional>
+#include <span>
+#include <string_view>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/thread_pool.hpp>
 
 #include "model.h"
 #include "collision_detector.h"
 #include "extra_data.h"
-#include "db_handler.h"
+#include "parallel_for.h"
+#include "records.h"
+#include "sessions_gate.h"
+#include "tick_arena.h"
 
 constexpr double WIDTH_PLAYER = 0.6;
 constexpr double WIDTH_OFFICE = 0.5;
@@ -22,23 +33,42 @@ constexpr double WIDTH_LOOT = 0.0;
 
 namespace players {
 
-using Token = std::string;
-    
+// Токен игрока: 128 случайных бит. Клиенту передаётся строкой из 32 шестнадцатеричных цифр
+struct Token {
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    static constexpr size_t STRING_LENGTH = 32;
+
+    // Разбирает строку из 32 шестнадцатеричных цифр, не выделяя памяти
+    static std::optional<Token> Parse(std::string_view text) noexcept;
+    std::string ToString() const;
+
+    bool operator==(const Token&) const = default;
+};
+
+struct TokenHasher {
+    size_t operator()(const Token& token) const noexcept {
+        // Биты токена и так случайны, достаточно смешать половины
+        return static_cast<size_t>(token.high ^ (token.low * 0x9E3779B97F4A7C15ull));
+    }
+};
+
 class Player {
 public:
-    Player(std::shared_ptr<model::Dog> dog, std::shared_ptr<model::GameSession> session, uint32_t id)
-        : dog_(std::move(dog)), session_(std::move(session)), id_(id) {}
+    Player(model::DogHandle dog, std::shared_ptr<model::GameSession> session, uint32_t id)
+        : dog_(dog), session_(std::move(session)), id_(id) {}
 
-    uint32_t GetPlayerDogId() const { return dog_->GetId(); }
-    std::shared_ptr<model::Dog>& GetDog() { return dog_; }
-    const std::shared_ptr<model::Dog>& ConstGetDog() const { return dog_; }
+    uint32_t GetPlayerDogId() const { return dog_.id; }
+    model::DogHandle GetDogHandle() const { return dog_; }
+    std::optional<model::DogRef> GetDog() { return session_->GetDog(dog_); }
     const std::shared_ptr<model::GameSession>& GetSession() const { return session_; }
     void AddToken (const Token& token) { token_ = token; }
-    Token GetToken () const { return token_; }
+    const Token& GetToken () const { return token_; }
     uint32_t GetId () const { return id_; }
 
 private:
-    std::shared_ptr<model::Dog> dog_;
+    model::DogHandle dog_;
     std::shared_ptr<model::GameSession> session_;
     Token token_;
     uint32_t id_;
@@ -47,17 +77,20 @@ private:
         
 class PlayerTokens {
 public:
-    PlayerTokens() : generator1_(random_device_()), generator2_(random_device_()) {}
+    // С seed токены воспроизводимы от прогона к прогону
+    explicit PlayerTokens(std::optional<uint64_t> seed = std::nullopt)
+        : generator1_(seed ? util::DeriveSeed(*seed, "token", 0) : random_device_())
+        , generator2_(seed ? util::DeriveSeed(*seed, "token", 1) : random_device_()) {}
 
     Token AddPlayerToken(std::shared_ptr<Player> player);
-    std::shared_ptr<Player> GetPlayerByToken(const Token& token);
+    std::shared_ptr<Player> GetPlayerByToken(const Token& token) const;
     void AddPlayerWithToken(std::shared_ptr<Player> player, const Token& token) { tokens_[token] = player; }
     void RemovePlayerToken(const Token& token);
 
 private:
     Token GenerateToken();
 
-    std::unordered_map<Token, std::shared_ptr<Player>> tokens_;
+    std::unordered_map<Token, std::shared_ptr<Player>, TokenHasher> tokens_;
     std::random_device random_device_;
     std::mt19937_64 generator1_;
     std::mt19937_64 generator2_;
@@ -65,25 +98,43 @@ private:
     
 class Players {
 public:
-    Players() : tokens_(std::make_shared<PlayerTokens>()) {}
+    explicit Players(std::optional<uint64_t> seed = std::nullopt) : tokens_(std::make_shared<PlayerTokens>(seed)) {}
 
-    std::shared_ptr<Player> AddPlayer(std::shared_ptr<model::Dog> dog, std::shared_ptr<model::GameSession> session);
-    std::shared_ptr<Player> GetPlayerById(uint32_t dog_id, const std::string& map_id);
-    std::shared_ptr<Player> GetPlayerByToken(const Token& token);
-    void RemovePlayer(std::shared_ptr<Player> player);
+    std::shared_ptr<Player> AddPlayer(model::DogHandle dog, std::shared_ptr<model::GameSession> session);
+    // Добавляет восстановленного игрока с уже выданным токеном
+    void RestorePlayer(std::shared_ptr<Player> player);
+    std::shared_ptr<Player> GetPlayerById(uint32_t dog_id, const model::GameSession& session) const;
+    std::shared_ptr<Player> GetPlayerByToken(const Token& token) const;
+    void RemovePlayer(const std::shared_ptr<Player>& player);
 
     const auto& GetPlayers() const { return players_; }
     uint32_t GetNextPlayerId() const { return next_id_player_; }
-    void SetPlayers(std::vector<std::shared_ptr<Player>>&& players) {
-        players_ = std::move(players);
-    }
     void SetNextPlayerId(uint32_t id) { next_id_player_ = id; }
 
-    void AddPlayerWithToken (std::shared_ptr<Player> player, const Token& token) { tokens_->AddPlayerWithToken(player, token); }
+private:
+    // Собака однозначно определяется сессией и своим id внутри неё
+    struct DogKey {
+        const model::GameSession* session;
+        uint32_t dog_id;
 
+        bool operator==(const DogKey&) const = default;
+    };
 
-private:
+    struct DogKeyHasher {
+        size_t operator()(const DogKey& key) const noexcept {
+            return std::hash<const void*>{}(key.session) * 37 + key.dog_id;
+        }
+    };
+
+    static DogKey KeyOf(const Player& player) {
+        return {player.GetSession().get(), player.GetPlayerDogId()};
+    }
+
+    void Index(std::shared_ptr<Player> player);
+
+    // Игроки лежат плотно, удаление переставляет последнего на место удалённого
     std::vector<std::shared_ptr<Player>> players_;
+    std::unordered_map<DogKey, size_t, DogKeyHasher> index_by_dog_;
     std::shared_ptr<PlayerTokens> tokens_;
     uint32_t next_id_player_ = 0;
 };
@@ -96,7 +147,7 @@ class JoinGameScenario {
 public:
     struct Result {
         uint32_t player_id;
-        std::string token;
+        players::Token token;
     };
 
     JoinGameScenario(model::Game& game, players::Players& players)
@@ -120,17 +171,20 @@ private:
     players::Players& players_;
 };
 
+// Результаты сценариев ниже ссылаются на данные сессии и действительны,
+// пока удерживается доступ к сессиям
 class PlayersScenario {
 public:
-    struct PlayerData {
-        uint32_t id;
-        std::string name;
+    struct Result {
+        const model::GameSession& session;
+        std::span<const uint32_t> ids;
+        std::span<const std::string> names;
     };
 
     PlayersScenario(players::Players& players)
         : players_(players) {}
 
-    std::vector<PlayerData> Execute(const players::Token& token);
+    std::optional<Result> Execute(const players::Token& token);
 
 private:
     players::Players& players_;
@@ -138,25 +192,16 @@ private:
 
 class GameStateScenario {
 public:
-    struct PlayerData {
-        uint32_t id;
-        model::Position position;
-        model::Velocity velocity;
-        model::Direction direction;
-        std::unordered_map<int, int> bag;
-        int points = 0;
-    };
-
-    struct LootData {
-        int id;
-        int type;
-        model::Position position;
+    struct Result {
+        const model::GameSession& session;
+        const model::DogStore& dogs;
+        std::span<const model::Loot> loots;
     };
 
     GameStateScenario(players::Players& players)
         : players_(players) {}
 
-    std::pair<std::vector<PlayerData>, std::vector<LootData>> Execute(const players::Token& token);
+    std::optional<Result> Execute(const players::Token& token);
 
 private:
     players::Players& players_;
@@ -187,31 +232,61 @@ private:
     model::Game& game_;
 };
 
+// Пул, на который тик раскидывает сессии, и сколько потоков его обслуживают.
+// Тип не стёрт: через any_io_executor задача помощника теряет свой аллокатор и уходит в кучу
+struct TickExecutor {
+    boost::asio::thread_pool::executor_type executor;
+    unsigned concurrency = 1;
+};
+
+// Арены для временных данных тика: общая и по одной на сессию, и состояние ParallelFor.
+// Живут в приложении между тиками
+struct TickArenas {
+    util::TickArena main;
+    std::vector<util::TickArena> sessions;
+    util::ParallelForState parallel_for;
+};
+
 class MoveDogsScenario {
 public:
-    MoveDogsScenario(model::Game& game, ExtraData& ex_data, players::Players& players, DbHandler& db_handler, double dog_retirement_time) 
-    : game_(game), ex_data_(ex_data), players_(players), db_handler_(db_handler), dog_retirement_time_(dog_retirement_time) {}
+    MoveDogsScenario(model::Game& game, ExtraData& ex_data, players::Players& players, RecordsRepository& records, double dog_retirement_time,
+                     TickArenas& arenas, const TickExecutor* executor = nullptr) 
+    : game_(game), ex_data_(ex_data), players_(players), records_(records), dog_retirement_time_(dog_retirement_time),
+      arenas_(arenas), executor_(executor) {}
 
     void Execute(std::chrono::milliseconds delta);
 
+    // Сдвигает собаку по дорогам за delta_time секунд. Открыт для микробенчмарков
+    static model::Position MoveDog(model::DogRef dog, const std::shared_ptr<model::Map>& map, double delta_time);
+
 private:
-model::Position MoveDog(model::Dog& dog, const std::shared_ptr<model::Map>& map, double delta_time);
+    // Собака, чьё время бездействия истекло. Удаляется, когда обработаны все сессии
+    struct Retirement {
+        model::DogHandle dog;
+        RetiredPlayer record;
+    };
+
+    // Меняет только состояние самой сессии, поэтому разные сессии обрабатываются параллельно
+    std::vector<Retirement> TickSession(model::GameSession& session, std::chrono::milliseconds delta,
+                                        std::pmr::memory_resource* resource) const;
 
     model::Game& game_;
     ExtraData& ex_data_;
     players::Players& players_;
-    DbHandler& db_handler_;
+    RecordsRepository& records_;
     double dog_retirement_time_;
+    TickArenas& arenas_;
+    const TickExecutor* executor_;
 };
 
 class RecordsScenario {
 public:
-    RecordsScenario(DbHandler& db_handler) : db_handler_(db_handler) {}
+    RecordsScenario(RecordsRepository& records) : records_(records) {}
 
     std::vector<RetiredPlayer> Execute(int start, int max_items);
 
 private:
-    DbHandler& db_handler_;
+    RecordsRepository& records_;
 };
 
 class ApplicationListener {
@@ -223,8 +298,9 @@ public:
 
 class Application {
 public:
-    Application(model::Game& game, ExtraData& ex_data, DbHandler& db_handler, double dog_retirement_time) 
-    : game_(game), ex_data_(ex_data), db_handler_(db_handler), dog_retirement_time_(dog_retirement_time) {}
+    Application(model::Game& game, ExtraData& ex_data, RecordsRepository& records, double dog_retirement_time) 
+    : game_(game), players_(game.GetRandomSeed()), ex_data_(ex_data), records_(records)
+    , dog_retirement_time_(dog_retirement_time) {}
 
     std::shared_ptr<JoinGameScenario> GetJoinGameScenario();
     std::shared_ptr<ActionGameScenario> GetActionGameScenario();
@@ -235,19 +311,38 @@ public:
     std::shared_ptr<MapByIdScenario> GetMapByIdScenario();
     std::shared_ptr<RecordsScenario> GetRecordsScenario();
 
+    // Тик под уже полученным монопольным доступом
+    void Tick(std::chrono::milliseconds delta, const SessionsGate::Pass& pass);
+    // Ждёт монопольного доступа, блокируя поток. Для бенчмарков и тестов
     void Tick(std::chrono::milliseconds delta);
+    // Ждёт монопольного доступа, не занимая поток, выполняет тик на executor и вызывает done
+    void AsyncTick(boost::asio::any_io_executor executor, std::chrono::milliseconds delta,
+                   std::function<void(std::exception_ptr)> done);
+
     players::Players& GetPlayers() { return players_; }
 
+    // Сессия игрока с этим токеном или nullptr. Вызывать с доступом к сессиям
+    std::shared_ptr<model::GameSession> FindPlayerSession(const players::Token& token);
+
+    SessionsGate& GetSessionsGate() { return sessions_gate_; }
+
     void AddListener(std::shared_ptr<ApplicationListener> listener) {
         listeners_.push_back(listener);
     }
 
+    void SetTickExecutor(TickExecutor executor) {
+        tick_executor_ = std::move(executor);
+    }
+
 private:
     model::Game& game_;
     players::Players players_;
     ExtraData& ex_data_;
-    DbHandler& db_handler_;
+    RecordsRepository& records_;
     double dog_retirement_time_;
+    std::optional<TickExecutor> tick_executor_;
+    TickArenas tick_arenas_;
+    SessionsGate sessions_gate_;
     std::vector<std::shared_ptr<ApplicationListener>> listeners_;
 };
 
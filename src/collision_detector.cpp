@@ -1,5 +1,22 @@
 #include "collision_detector.h"
 #include <cassert>
+#include <cmath>
+#include <numeric>
+#include <optional>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define COLLISION_DETECTOR_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define COLLISION_DETECTOR_X86_SIMD 0
+#endif
+
+// Ядро AVX2 собирается через target-атрибут GCC/Clang и выбирается во время выполнения
+#if COLLISION_DETECTOR_X86_SIMD && (defined(__GNUC__) || defined(__clang__))
+#define COLLISION_DETECTOR_AVX2 1
+#else
+#define COLLISION_DETECTOR_AVX2 0
+#endif
 
 namespace collision_detector {
 
@@ -19,11 +36,295 @@ CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D
     return CollectionResult(sq_distance, proj_ratio);
 }
 
-std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
-    std::vector<GatheringEvent> events;
+namespace {
 
-    for (size_t gatherer_id = 0; gatherer_id < provider.GatherersCount(); ++gatherer_id) {
-        const auto gatherer = provider.GetGatherer(gatherer_id);
+// Меньше предметов — дешевле перебрать их все, чем строить сетку
+constexpr size_t GRID_MIN_ITEMS = 16;
+// Запас широкой фазы на погрешность вычислений узкой фазы
+constexpr double BROAD_PHASE_MARGIN = 1e-6;
+
+}  // namespace
+
+ItemGrid::ItemGrid(std::span<const Item> items, std::pmr::memory_resource* resource)
+    : cell_start_(resource)
+    , item_indices_(resource) {
+    if (items.empty()) {
+        cell_start_.assign(2, 0);
+        return;
+    }
+
+    double max_x = items.front().position.x;
+    double max_y = items.front().position.y;
+    min_x_ = max_x;
+    min_y_ = max_y;
+    for (const auto& item : items) {
+        min_x_ = std::min(min_x_, item.position.x);
+        min_y_ = std::min(min_y_, item.position.y);
+        max_x = std::max(max_x, item.position.x);
+        max_y = std::max(max_y, item.position.y);
+    }
+
+    // В среднем около одного предмета на ячейку
+    const double width = max_x - min_x_;
+    const double height = max_y - min_y_;
+    const double count = static_cast<double>(items.size());
+    cell_size_ = width * height > 0 ? std::sqrt(width * height / count) : std::max(width, height) / count;
+    if (!(cell_size_ > 0)) {
+        cell_size_ = 1.0;
+    }
+    const size_t max_cells = 4 * items.size() + 16;
+    while (true) {
+        columns_ = static_cast<size_t>(width / cell_size_) + 1;
+        rows_ = static_cast<size_t>(height / cell_size_) + 1;
+        if (columns_ * rows_ <= max_cells) {
+            break;
+        }
+        cell_size_ *= 2;
+    }
+
+    // Сортировка подсчётом сохраняет возрастание индексов внутри ячейки
+    std::pmr::vector<size_t> item_cells(items.size(), resource);
+    cell_start_.assign(columns_ * rows_ + 1, 0);
+    for (size_t i = 0; i < items.size(); ++i) {
+        item_cells[i] = CellRow(items[i].position.y) * columns_ + CellColumn(items[i].position.x);
+        ++cell_start_[item_cells[i] + 1];
+    }
+    for (size_t c = 0; c + 1 < cell_start_.size(); ++c) {
+        cell_start_[c + 1] += cell_start_[c];
+    }
+    item_indices_.resize(items.size());
+    std::pmr::vector<size_t> fill(cell_start_.begin(), cell_start_.end() - 1, resource);
+    for (size_t i = 0; i < items.size(); ++i) {
+        item_indices_[fill[item_cells[i]]++] = i;
+    }
+}
+
+namespace {
+
+// Номер ячейки, ограниченный [0, count - 1]. Ограничивать приходится до приведения:
+// double вне диапазона size_t (собиратель далеко за сеткой, огромный радиус) приводить нельзя
+size_t ClampCell(double cell, size_t count) {
+    if (!(cell > 0)) {
+        return 0;
+    }
+    const double last = static_cast<double>(count - 1);
+    return cell < last ? static_cast<size_t>(cell) : count - 1;
+}
+
+}  // namespace
+
+size_t ItemGrid::CellColumn(double x) const {
+    return ClampCell((x - min_x_) / cell_size_, columns_);
+}
+
+size_t ItemGrid::CellRow(double y) const {
+    return ClampCell((y - min_y_) / cell_size_, rows_);
+}
+
+void ItemGrid::QueryRanges(geom::Point2D a, geom::Point2D b, double radius, std::pmr::vector<Range>& out) const {
+    out.clear();
+
+    const size_t first_column = CellColumn(std::min(a.x, b.x) - radius);
+    const size_t last_column = CellColumn(std::max(a.x, b.x) + radius);
+    const size_t first_row = CellRow(std::min(a.y, b.y) - radius);
+    const size_t last_row = CellRow(std::max(a.y, b.y) + radius);
+
+    for (size_t row = first_row; row <= last_row; ++row) {
+        const size_t begin = cell_start_[row * columns_ + first_column];
+        const size_t end = cell_start_[row * columns_ + last_column + 1];
+        if (begin != end) {
+            out.emplace_back(begin, end);
+        }
+    }
+}
+
+namespace {
+
+void CollectPointsScalar(geom::Point2D a, geom::Point2D b, double gatherer_width,
+                         const double* xs, const double* ys, const double* widths, size_t count,
+                         size_t offset, std::pmr::vector<BatchHit>& hits) {
+    for (size_t i = 0; i < count; ++i) {
+        const CollectionResult result = TryCollectPoint(a, b, {xs[i], ys[i]});
+        if (result.IsCollected(gatherer_width + widths[i])) {
+            hits.push_back({offset + i, result.sq_distance, result.proj_ratio});
+        }
+    }
+}
+
+#if COLLISION_DETECTOR_X86_SIMD
+
+// Векторные ядра повторяют порядок операций TryCollectPoint без FMA,
+// поэтому результаты совпадают со скалярными бит в бит
+
+void CollectPointsSse2(geom::Point2D a, geom::Point2D b, double gatherer_width,
+                       const double* xs, const double* ys, const double* widths, size_t count,
+                       size_t offset, std::pmr::vector<BatchHit>& hits) {
+    const double v_x = b.x - a.x;
+    const double v_y = b.y - a.y;
+    const __m128d a_x = _mm_set1_pd(a.x);
+    const __m128d a_y = _mm_set1_pd(a.y);
+    const __m128d vec_v_x = _mm_set1_pd(v_x);
+    const __m128d vec_v_y = _mm_set1_pd(v_y);
+    const __m128d v_len2 = _mm_set1_pd(v_x * v_x + v_y * v_y);
+    const __m128d width = _mm_set1_pd(gatherer_width);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one = _mm_set1_pd(1.0);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128d u_x = _mm_sub_pd(_mm_loadu_pd(xs + i), a_x);
+        const __m128d u_y = _mm_sub_pd(_mm_loadu_pd(ys + i), a_y);
+        const __m128d u_dot_v = _mm_add_pd(_mm_mul_pd(u_x, vec_v_x), _mm_mul_pd(u_y, vec_v_y));
+        const __m128d u_len2 = _mm_add_pd(_mm_mul_pd(u_x, u_x), _mm_mul_pd(u_y, u_y));
+        const __m128d proj_ratio = _mm_div_pd(u_dot_v, v_len2);
+        const __m128d sq_distance = _mm_sub_pd(u_len2, _mm_div_pd(_mm_mul_pd(u_dot_v, u_dot_v), v_len2));
+        const __m128d radius = _mm_add_pd(width, _mm_loadu_pd(widths + i));
+
+        const __m128d collected = _mm_and_pd(
+            _mm_and_pd(_mm_cmpge_pd(proj_ratio, zero), _mm_cmple_pd(proj_ratio, one)),
+            _mm_cmple_pd(sq_distance, _mm_mul_pd(radius, radius)));
+        int mask = _mm_movemask_pd(collected);
+        if (mask != 0) {
+            alignas(16) double proj[2];
+            alignas(16) double dist[2];
+            _mm_store_pd(proj, proj_ratio);
+            _mm_store_pd(dist, sq_distance);
+            for (int lane = 0; lane < 2; ++lane) {
+                if (mask & (1 << lane)) {
+                    hits.push_back({offset + i + lane, dist[lane], proj[lane]});
+                }
+            }
+        }
+    }
+    CollectPointsScalar(a, b, gatherer_width, xs + i, ys + i, widths + i, count - i, offset + i, hits);
+}
+
+#if COLLISION_DETECTOR_AVX2
+
+__attribute__((target("avx2")))
+void CollectPointsAvx2(geom::Point2D a, geom::Point2D b, double gatherer_width,
+                       const double* xs, const double* ys, const double* widths, size_t count,
+                       size_t offset, std::pmr::vector<BatchHit>& hits) {
+    const double v_x = b.x - a.x;
+    const double v_y = b.y - a.y;
+    const __m256d a_x = _mm256_set1_pd(a.x);
+    const __m256d a_y = _mm256_set1_pd(a.y);
+    const __m256d vec_v_x = _mm256_set1_pd(v_x);
+    const __m256d vec_v_y = _mm256_set1_pd(v_y);
+    const __m256d v_len2 = _mm256_set1_pd(v_x * v_x + v_y * v_y);
+    const __m256d width = _mm256_set1_pd(gatherer_width);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256d u_x = _mm256_sub_pd(_mm256_loadu_pd(xs + i), a_x);
+        const __m256d u_y = _mm256_sub_pd(_mm256_loadu_pd(ys + i), a_y);
+        const __m256d u_dot_v = _mm256_add_pd(_mm256_mul_pd(u_x, vec_v_x), _mm256_mul_pd(u_y, vec_v_y));
+        const __m256d u_len2 = _mm256_add_pd(_mm256_mul_pd(u_x, u_x), _mm256_mul_pd(u_y, u_y));
+        const __m256d proj_ratio = _mm256_div_pd(u_dot_v, v_len2);
+        const __m256d sq_distance = _mm256_sub_pd(u_len2, _mm256_div_pd(_mm256_mul_pd(u_dot_v, u_dot_v), v_len2));
+        const __m256d radius = _mm256_add_pd(width, _mm256_loadu_pd(widths + i));
+
+        const __m256d collected = _mm256_and_pd(
+            _mm256_and_pd(_mm256_cmp_pd(proj_ratio, zero, _CMP_GE_OQ), _mm256_cmp_pd(proj_ratio, one, _CMP_LE_OQ)),
+            _mm256_cmp_pd(sq_distance, _mm256_mul_pd(radius, radius), _CMP_LE_OQ));
+        int mask = _mm256_movemask_pd(collected);
+        if (mask != 0) {
+            alignas(32) double proj[4];
+            alignas(32) double dist[4];
+            _mm256_store_pd(proj, proj_ratio);
+            _mm256_store_pd(dist, sq_distance);
+            for (int lane = 0; lane < 4; ++lane) {
+                if (mask & (1 << lane)) {
+                    hits.push_back({offset + i + lane, dist[lane], proj[lane]});
+                }
+            }
+        }
+    }
+    CollectPointsSse2(a, b, gatherer_width, xs + i, ys + i, widths + i, count - i, offset + i, hits);
+}
+
+#endif  // COLLISION_DETECTOR_AVX2
+#endif  // COLLISION_DETECTOR_X86_SIMD
+
+}  // namespace
+
+BatchKernel GetBestBatchKernel() {
+    static const BatchKernel kernel = [] {
+#if COLLISION_DETECTOR_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return BatchKernel::AVX2;
+        }
+#endif
+#if COLLISION_DETECTOR_X86_SIMD
+        return BatchKernel::SSE2;
+#else
+        return BatchKernel::SCALAR;
+#endif
+    }();
+    return kernel;
+}
+
+void CollectPointsBatch(BatchKernel kernel, geom::Point2D a, geom::Point2D b, double gatherer_width,
+                        const double* xs, const double* ys, const double* widths, size_t count,
+                        size_t offset, std::pmr::vector<BatchHit>& hits) {
+    assert(b.x != a.x || b.y != a.y);
+    switch (kernel) {
+#if COLLISION_DETECTOR_AVX2
+        case BatchKernel::AVX2:
+            return CollectPointsAvx2(a, b, gatherer_width, xs, ys, widths, count, offset, hits);
+#endif
+#if COLLISION_DETECTOR_X86_SIMD
+        case BatchKernel::SSE2:
+            return CollectPointsSse2(a, b, gatherer_width, xs, ys, widths, count, offset, hits);
+#endif
+        default:
+            return CollectPointsScalar(a, b, gatherer_width, xs, ys, widths, count, offset, hits);
+    }
+}
+
+void FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                      std::pmr::vector<GatheringEvent>& events) {
+    std::pmr::memory_resource* resource = events.get_allocator().resource();
+    events.clear();
+
+    double max_item_width = 0.0;
+    for (const auto& item : items) {
+        max_item_width = std::max(max_item_width, item.width);
+    }
+
+    std::optional<ItemGrid> grid;
+    if (items.size() >= GRID_MIN_ITEMS) {
+        grid.emplace(items, resource);
+    }
+
+    // Предметы раскладываются по массивам в порядке сетки: строка сетки — непрерывный диапазон
+    std::pmr::vector<size_t> identity_order(resource);
+    std::span<const size_t> order;
+    if (grid) {
+        order = grid->GetOrder();
+    } else {
+        identity_order.resize(items.size());
+        std::iota(identity_order.begin(), identity_order.end(), size_t{0});
+        order = identity_order;
+    }
+    std::pmr::vector<double> xs(items.size(), resource);
+    std::pmr::vector<double> ys(items.size(), resource);
+    std::pmr::vector<double> widths(items.size(), resource);
+    for (size_t pos = 0; pos < order.size(); ++pos) {
+        const Item& item = items[order[pos]];
+        xs[pos] = item.position.x;
+        ys[pos] = item.position.y;
+        widths[pos] = item.width;
+    }
+
+    const BatchKernel kernel = GetBestBatchKernel();
+    std::pmr::vector<ItemGrid::Range> ranges(resource);
+    std::pmr::vector<BatchHit> hits(resource);
+
+    for (const auto& gatherer : gatherers) {
         const geom::Point2D a = gatherer.start_pos;
         const geom::Point2D b = gatherer.end_pos;
 
@@ -31,30 +332,63 @@ std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provide
             continue;
         }
 
-        for (size_t item_id = 0; item_id < provider.ItemsCount(); ++item_id) {
-            const auto item = provider.GetItem(item_id);
-            const geom::Point2D c = item.position;
-            const double total_radius = gatherer.width + item.width;
+        if (grid) {
+            grid->QueryRanges(a, b, gatherer.width + max_item_width + BROAD_PHASE_MARGIN, ranges);
+        } else {
+            ranges.assign(1, {0, items.size()});
+        }
 
-            CollectionResult result = TryCollectPoint(a, b, c);
+        hits.clear();
+        for (auto [begin, end] : ranges) {
+            CollectPointsBatch(kernel, a, b, gatherer.width, xs.data() + begin, ys.data() + begin,
+                               widths.data() + begin, end - begin, begin, hits);
+        }
 
-            if (result.IsCollected(total_radius)) {
-                events.push_back({
-                    static_cast<size_t>(item.id),
-                    static_cast<size_t>(gatherer.id),
-                    result.sq_distance,
-                    result.proj_ratio
-                });
-            }
+        // Порядок проверки предметов должен совпадать с полным перебором
+        for (auto& hit : hits) {
+            hit.index = order[hit.index];
+        }
+        if (grid) {
+            std::sort(hits.begin(), hits.end(), [](const BatchHit& lhs, const BatchHit& rhs) {
+                return lhs.index < rhs.index;
+            });
+        }
+
+        for (const auto& hit : hits) {
+            events.push_back({
+                static_cast<size_t>(items[hit.index].id),
+                static_cast<size_t>(gatherer.id),
+                hit.sq_distance,
+                hit.proj_ratio
+            });
         }
     }
 
     std::sort(events.begin(), events.end(), [](const GatheringEvent& lhs, const GatheringEvent& rhs) {
         return lhs.time < rhs.time;
     });
+}
+
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers) {
+    std::pmr::vector<GatheringEvent> events;
+    FindGatherEvents(items, gatherers, events);
+    return {events.begin(), events.end()};
+}
 
-    return events;
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
+    std::vector<Item> items;
+    items.reserve(provider.ItemsCount());
+    for (size_t item_id = 0; item_id < provider.ItemsCount(); ++item_id) {
+        items.push_back(provider.GetItem(item_id));
+    }
+
+    std::vector<Gatherer> gatherers;
+    gatherers.reserve(provider.GatherersCount());
+    for (size_t gatherer_id = 0; gatherer_id < provider.GatherersCount(); ++gatherer_id) {
+        gatherers.push_back(provider.GetGatherer(gatherer_id));
+    }
 
+    return FindGatherEvents(std::span<const Item>{items}, std::span<const Gatherer>{gatherers});
 }
 
 
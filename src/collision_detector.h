@@ -3,6 +3,10 @@
 #include "geom.h"
 
 #include <algorithm>
+#include <concepts>
+#include <memory_resource>
+#include <span>
+#include <utility>
 #include <vector>
 
 namespace collision_detector {
@@ -44,6 +48,14 @@ public:
     virtual Gatherer GetGatherer(size_t idx) const = 0;
 };
 
+// Источник предметов и собирателей, хранящихся непрерывно. Такие источники
+// обрабатываются без виртуальных вызовов и копирования
+template <typename T>
+concept ItemGathererSpans = requires(const T& provider) {
+    { provider.GetItems() } -> std::convertible_to<std::span<const Item>>;
+    { provider.GetGatherers() } -> std::convertible_to<std::span<const Gatherer>>;
+};
+
 struct Provider : public ItemGathererProvider {
     const std::vector<Item>& items;
     const std::vector<Gatherer>& gatherers;
@@ -55,8 +67,73 @@ struct Provider : public ItemGathererProvider {
     Item GetItem(size_t idx) const override { return items[idx]; }
     size_t GatherersCount() const override { return gatherers.size(); }
     Gatherer GetGatherer(size_t idx) const override { return gatherers[idx]; }
+
+    std::span<const Item> GetItems() const { return items; }
+    std::span<const Gatherer> GetGatherers() const { return gatherers; }
+};
+
+// Равномерная сетка по позициям предметов — широкая фаза поиска столкновений.
+// Отбирает предметы, попадающие в габаритный прямоугольник отрезка движения собирателя
+class ItemGrid {
+public:
+    // Полуинтервал позиций в порядке GetOrder()
+    using Range = std::pair<size_t, size_t>;
+
+    explicit ItemGrid(std::span<const Item> items, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Индексы предметов, упорядоченные по ячейкам (строка за строкой),
+    // внутри ячейки — по возрастанию
+    std::span<const size_t> GetOrder() const noexcept {
+        return item_indices_;
+    }
+
+    // Диапазоны позиций GetOrder(), покрывающие прямоугольник отрезка [a, b],
+    // расширенный на radius. По одному диапазону на строку сетки
+    void QueryRanges(geom::Point2D a, geom::Point2D b, double radius, std::pmr::vector<Range>& out) const;
+
+private:
+    size_t CellColumn(double x) const;
+    size_t CellRow(double y) const;
+
+    double min_x_ = 0.0;
+    double min_y_ = 0.0;
+    double cell_size_ = 1.0;
+    size_t columns_ = 1;
+    size_t rows_ = 1;
+    // Предметы ячейки c лежат в item_indices_[cell_start_[c], cell_start_[c + 1])
+    std::pmr::vector<size_t> cell_start_;
+    std::pmr::vector<size_t> item_indices_;
+};
+
+// Пакетная проверка предметов, заданных раздельными массивами (structure of arrays)
+struct BatchHit {
+    size_t index;
+    double sq_distance;
+    double proj_ratio;
 };
 
+enum class BatchKernel {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// Лучшее ядро, поддерживаемое процессором. Определяется один раз при первом вызове
+BatchKernel GetBestBatchKernel();
+
+// Проверяет отрезок [a, b] собирателя ширины gatherer_width против count предметов.
+// Для предметов, прошедших CollectionResult::IsCollected, добавляет в hits запись
+// с индексом offset + i. Результаты совпадают с TryCollectPoint бит в бит
+void CollectPointsBatch(BatchKernel kernel, geom::Point2D a, geom::Point2D b, double gatherer_width,
+                        const double* xs, const double* ys, const double* widths, size_t count,
+                        size_t offset, std::pmr::vector<BatchHit>& hits);
+
+inline void CollectPointsBatch(geom::Point2D a, geom::Point2D b, double gatherer_width,
+                               const double* xs, const double* ys, const double* widths, size_t count,
+                               size_t offset, std::pmr::vector<BatchHit>& hits) {
+    CollectPointsBatch(GetBestBatchKernel(), a, b, gatherer_width, xs, ys, widths, count, offset, hits);
+}
+
 struct GatheringEvent {
     size_t item_id;
     size_t gatherer_id;
@@ -64,6 +141,19 @@ struct GatheringEvent {
     double time;
 };
 
+// Заменяет содержимое events. Временные буферы берутся из того же ресурса памяти, что и events,
+// поэтому с ресурсом-ареной поиск не обращается к куче
+void FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers,
+                      std::pmr::vector<GatheringEvent>& events);
+
+std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items, std::span<const Gatherer> gatherers);
+
+template <ItemGathererSpans SpanProvider>
+std::vector<GatheringEvent> FindGatherEvents(const SpanProvider& provider) {
+    return FindGatherEvents(provider.GetItems(), provider.GetGatherers());
+}
+
+// Адаптер для источников с виртуальным интерфейсом: данные копируются один раз
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
 
 }  // namespace collision_detector
\ No newline at end of file
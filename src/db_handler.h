@@ -2,23 +2,18 @@
 
 #include "db_connection_pool.h"
 #include "tagged_uuid.h"
+#include "records.h"
 #include <string>
 #include <vector>
 #include <chrono>
 
-struct RetiredPlayer {
-    std::string name;
-    int score;
-    int64_t play_time_ms;
-};
-
-class DbHandler {
+class DbHandler : public RecordsRepository {
 public:
     explicit DbHandler(const std::string& db_url, size_t pool_size = std::thread::hardware_concurrency());
 
     void InitializeDatabase();
-    void SaveRetiredPlayer(const RetiredPlayer& player);
-    std::vector<RetiredPlayer> GetRecords(int start, int max_items);
+    void SaveRetiredPlayer(const RetiredPlayer& player) override;
+    std::vector<RetiredPlayer> GetRecords(int start, int max_items) override;
 
 private:
     ConnectionPool pool_;
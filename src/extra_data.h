@@ -23,11 +23,11 @@ public:
         return loots_in_map_.at(map).as_array();
     }
 
-    int GetValueLoot(const std::string& map, int type) {
+    int GetValueLoot(const std::string& map, int type) const {
         if (!loots_in_map_.contains(map)) {
             throw "No map for value";
         }
-        array& loot_array = loots_in_map_[map].as_array();
+        const array& loot_array = loots_in_map_.at(map).as_array();
         return loot_array[type].at("value").as_int64();
     }
 
@@ -0,0 +1,128 @@
+#include "http_cache.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+
+namespace http_handler {
+
+namespace {
+
+std::string_view Trim(std::string_view text) {
+    const auto first = text.find_first_not_of(" \t");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
+
+std::string_view StripWeak(std::string_view etag) {
+    return etag.starts_with("W/") ? etag.substr(2) : etag;
+}
+
+}  // namespace
+
+CachedBody MakeCachedBody(std::string body) {
+    auto etag = MakeStrongETag(body);
+    return {std::make_shared<const std::string>(std::move(body)), std::move(etag)};
+}
+
+std::string MakeStrongETag(std::string_view body) {
+    uint64_t hash = 0xCBF29CE484222325ull;  // FNV-1a
+    for (char c : body) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    char etag[48];
+    const int size = std::snprintf(etag, sizeof(etag), "\"%016llx-%zx\"", static_cast<unsigned long long>(hash), body.size());
+    return {etag, static_cast<size_t>(size)};
+}
+
+bool MatchesIfNoneMatch(std::string_view if_none_match, std::string_view etag) {
+    etag = StripWeak(etag);
+    while (!if_none_match.empty()) {
+        const auto comma = if_none_match.find(',');
+        const auto candidate = Trim(if_none_match.substr(0, comma));
+        if (candidate == "*" || StripWeak(candidate) == etag) {
+            return true;
+        }
+        if_none_match = comma == std::string_view::npos ? std::string_view{} : if_none_match.substr(comma + 1);
+    }
+    return false;
+}
+
+RangeRequest ParseRange(std::string_view range, uint64_t size) {
+    using Kind = RangeRequest::Kind;
+    constexpr std::string_view BYTES_PREFIX = "bytes=";
+
+    range = Trim(range);
+    if (!range.starts_with(BYTES_PREFIX) || range.find(',') != std::string_view::npos) {
+        return {};
+    }
+    range = Trim(range.substr(BYTES_PREFIX.size()));
+    const auto dash = range.find('-');
+    if (dash == std::string_view::npos) {
+        return {};
+    }
+
+    const auto parse = [](std::string_view text, uint64_t& value) {
+        const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc{} && end == text.data() + text.size();
+    };
+    const auto first_text = Trim(range.substr(0, dash));
+    const auto last_text = Trim(range.substr(dash + 1));
+
+    if (first_text.empty()) {
+        // Последние n байт
+        uint64_t suffix = 0;
+        if (!parse(last_text, suffix)) {
+            return {};
+        }
+        if (suffix == 0 || size == 0) {
+            return {Kind::UNSATISFIABLE};
+        }
+        suffix = std::min(suffix, size);
+        return {Kind::PARTIAL, size - suffix, suffix};
+    }
+
+    uint64_t first = 0;
+    uint64_t last = size == 0 ? 0 : size - 1;
+    if (!parse(first_text, first) || (!last_text.empty() && !parse(last_text, last))) {
+        return {};
+    }
+    if (!last_text.empty() && last < first) {
+        return {};
+    }
+    if (first >= size) {
+        return {Kind::UNSATISFIABLE};
+    }
+    last = std::min(last, size - 1);
+    return {Kind::PARTIAL, first, last - first + 1};
+}
+
+bool AcceptsEncoding(std::string_view accept_encoding, std::string_view coding) {
+    while (!accept_encoding.empty()) {
+        const auto comma = accept_encoding.find(',');
+        const auto item = accept_encoding.substr(0, comma);
+        const auto semicolon = item.find(';');
+        const auto name = Trim(item.substr(0, semicolon));
+        if (name == coding || name == "*") {
+            if (semicolon == std::string_view::npos) {
+                return true;
+            }
+            const auto params = item.substr(semicolon + 1);
+            const auto q = params.find("q=");
+            if (q == std::string_view::npos) {
+                return true;
+            }
+            double weight = 1.0;
+            const auto value = Trim(params.substr(q + 2));
+            std::from_chars(value.data(), value.data() + value.size(), weight);
+            return weight > 0.0;
+        }
+        accept_encoding = comma == std::string_view::npos ? std::string_view{} : accept_encoding.substr(comma + 1);
+    }
+    return false;
+}
+
+}  // namespace http_handler
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace http_handler {
+
+// Неизменяемое тело ответа вместе с его строгим ETag
+struct CachedBody {
+    std::shared_ptr<const std::string> body;
+    std::string etag;
+};
+
+CachedBody MakeCachedBody(std::string body);
+
+// Строгий ETag по содержимому: одинаковые тела получают одинаковый тег на любом экземпляре сервера
+std::string MakeStrongETag(std::string_view body);
+
+// Совпадает ли etag с одним из тегов заголовка If-None-Match. Сравнение слабое, как требует RFC 9110
+bool MatchesIfNoneMatch(std::string_view if_none_match, std::string_view etag);
+
+// Что просит заголовок Range у ресурса известного размера
+struct RangeRequest {
+    enum class Kind {
+        // Диапазона нет, он не в байтах, их несколько или заголовок некорректен — отдаётся весь ресурс
+        FULL,
+        PARTIAL,
+        UNSATISFIABLE
+    };
+
+    Kind kind = Kind::FULL;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+// Понимает один диапазон байт: "bytes=a-b", "bytes=a-" и "bytes=-n"
+RangeRequest ParseRange(std::string_view range, uint64_t size);
+
+// Разрешает ли заголовок Accept-Encoding кодировку coding, явно или через "*", с ненулевым q
+bool AcceptsEncoding(std::string_view accept_encoding, std::string_view coding);
+
+}  // namespace http_handler
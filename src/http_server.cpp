@@ -2,8 +2,14 @@
 #include "json_logger.h"
 
 #include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
 #include <iostream>
 
+#ifdef __linux__
+#include <cerrno>
+#include <sys/sendfile.h>
+#endif
+
 namespace http_server {
 
 void ReportError(beast::error_code ec, std::string_view what) {
@@ -53,4 +59,213 @@ void SessionBase::Close() {
     }
 }
 
+#ifdef __linux__
+// Заголовок пишет Beast, тело уходит через sendfile без копирования в пространство пользователя
+struct SessionBase::SendFileState {
+    SendFileState(http::response<FileRangeBody>&& response, const tcp::socket::executor_type& executor)
+        : response(std::move(response)), serializer(this->response), timer(executor) {}
+
+    http::response<FileRangeBody> response;
+    http::response_serializer<FileRangeBody> serializer;
+    net::steady_timer timer;
+    std::uint64_t sent = 0;
+};
+
+void SessionBase::SendFile(http::response<FileRangeBody>&& response) {
+    auto state = std::make_shared<SendFileState>(std::move(response), stream_.socket().get_executor());
+    stream_.expires_after(30s);
+    http::async_write_header(stream_, state->serializer,
+                             [state, self = GetSharedThis()](beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+                                 if (ec) {
+                                     return ReportError(ec, "write"sv);
+                                 }
+                                 self->SendFileChunk(state);
+                             });
+}
+
+void SessionBase::SendFileChunk(const std::shared_ptr<SendFileState>& state) {
+    auto& socket = stream_.socket();
+    auto& body = state->response.body();
+
+    beast::error_code ec;
+    socket.native_non_blocking(true, ec);
+    if (ec) {
+        return ReportError(ec, "sendfile"sv);
+    }
+
+    std::size_t budget = SENDFILE_BUDGET;
+    while (state->sent < body.size) {
+        if (budget == 0) {
+            return net::post(stream_.get_executor(), [state, self = GetSharedThis()] {
+                self->SendFileChunk(state);
+            });
+        }
+
+        auto offset = static_cast<off_t>(body.offset + state->sent);
+        const auto count = static_cast<std::size_t>(std::min<std::uint64_t>(body.size - state->sent, budget));
+        const ssize_t sent = ::sendfile(socket.native_handle(), body.file.native_handle(), &offset, count);
+        if (sent > 0) {
+            state->sent += static_cast<std::uint64_t>(sent);
+            budget -= static_cast<std::size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Буфер сокета полон: ждём клиента, но не дольше таймаута
+            state->timer.expires_after(30s);
+            state->timer.async_wait([state, self = GetSharedThis()](beast::error_code ec) {
+                if (!ec) {
+                    self->stream_.socket().cancel(ec);
+                }
+            });
+            socket.async_wait(tcp::socket::wait_write, [state, self = GetSharedThis()](beast::error_code ec) {
+                state->timer.cancel();
+                if (ec) {
+                    return ReportError(ec, "sendfile"sv);
+                }
+                self->SendFileChunk(state);
+            });
+            return;
+        }
+        // Ноль байт — файл оказался короче, чем при индексации
+        ec = sent == 0 ? beast::error_code{http::error::short_read} : beast::error_code{errno, sys::system_category()};
+        return ReportError(ec, "sendfile"sv);
+    }
+
+    OnWrite(state->response.need_eof(), {}, static_cast<std::size_t>(state->sent));
+}
+#endif
+
+void RejectUpgrade(beast::tcp_stream&& stream, http::response<http::string_body>&& response) {
+    struct Rejection {
+        beast::tcp_stream stream;
+        http::response<http::string_body> response;
+    };
+
+    auto rejection = std::make_shared<Rejection>(std::move(stream), std::move(response));
+    rejection->response.keep_alive(false);
+    rejection->stream.expires_after(30s);
+    http::async_write(rejection->stream, rejection->response,
+                      [rejection](beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+                          if (ec) {
+                              return ReportError(ec, "write"sv);
+                          }
+                          rejection->stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+                      });
+}
+
+WebSocketSession::WebSocketSession(beast::tcp_stream&& stream)
+    : ws_(std::move(stream)) {
+    // Соединение живёт долго, за простоем следит сам websocket::stream
+    beast::get_lowest_layer(ws_).expires_never();
+    ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+    ws_.text(true);
+}
+
+void WebSocketSession::Run(HttpRequest&& request) {
+    request_ = std::move(request);
+    net::dispatch(ws_.get_executor(), [self = shared_from_this()] {
+        self->ws_.async_accept(self->request_, beast::bind_front_handler(&WebSocketSession::OnAccept, self));
+    });
+}
+
+void WebSocketSession::Send(Frame frame) {
+    net::post(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+        self->Enqueue(std::move(frame));
+    });
+}
+
+void WebSocketSession::Close(websocket::close_reason reason) {
+    net::post(ws_.get_executor(), [self = shared_from_this(), reason] {
+        if (!self->open_) {
+            return;
+        }
+        self->open_ = false;
+        // До рукопожатия закрывать нечего, OnAccept закроет соединение сам
+        if (self->accepted_) {
+            self->DoClose(reason);
+        }
+    });
+}
+
+void WebSocketSession::DoClose(websocket::close_reason reason) {
+    ws_.async_close(reason, [self = shared_from_this()](beast::error_code ec) {
+        if (ec && ec != net::error::operation_aborted) {
+            ReportError(ec, "close"sv);
+        }
+    });
+}
+
+void WebSocketSession::OnAccept(beast::error_code ec) {
+    request_ = {};
+    if (ec) {
+        open_ = false;
+        return ReportError(ec, "accept"sv);
+    }
+    accepted_ = true;
+    if (!open_) {
+        return DoClose(websocket::close_code::normal);
+    }
+    Read();
+    if (!queue_.empty()) {
+        Write();
+    }
+}
+
+void WebSocketSession::Read() {
+    ws_.async_read(buffer_, beast::bind_front_handler(&WebSocketSession::OnRead, shared_from_this()));
+}
+
+void WebSocketSession::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+    if (ec) {
+        open_ = false;
+        if (ec != websocket::error::closed && ec != net::error::operation_aborted) {
+            ReportError(ec, "read"sv);
+        }
+        return;
+    }
+    buffer_.consume(buffer_.size());
+    Read();
+}
+
+void WebSocketSession::Enqueue(Frame frame) {
+    if (!open_) {
+        return;
+    }
+    const size_t pending = queue_.size() - (writing_ ? 1 : 0);
+    if (pending < MAX_PENDING_FRAMES) {
+        queue_.push_back(std::move(frame));
+    } else {
+        // Клиент отстаёт: ожидающий кадр устарел, отправим только свежий
+        queue_.back() = std::move(frame);
+    }
+    if (accepted_ && !writing_) {
+        Write();
+    }
+}
+
+void WebSocketSession::Write() {
+    writing_ = true;
+    ws_.async_write(net::buffer(*queue_.front()),
+                    beast::bind_front_handler(&WebSocketSession::OnWrite, shared_from_this()));
+}
+
+void WebSocketSession::OnWrite(beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+    writing_ = false;
+    queue_.pop_front();
+    if (ec) {
+        open_ = false;
+        queue_.clear();
+        if (ec != websocket::error::closed && ec != net::error::operation_aborted) {
+            ReportError(ec, "write"sv);
+        }
+        return;
+    }
+    if (open_ && !queue_.empty()) {
+        Write();
+    }
+}
+
 }  // namespace http_server
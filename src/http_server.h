@@ -3,10 +3,19 @@
 #include "sdk.h"
 //
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <string>
 
 #include "json_logger.h"
 
@@ -16,11 +25,146 @@ namespace net = boost::asio;
 using tcp = net::ip::tcp;
 namespace beast = boost::beast;
 namespace http = beast::http;
+namespace websocket = beast::websocket;
 namespace sys = boost::system;
 using namespace std::literals;
 
 void ReportError(beast::error_code ec, std::string_view what);
 
+// Тело ответа из неизменяемого общего буфера. Уходит в сокет без копирования,
+// буфер живёт, пока ответ не записан
+struct SharedBufferBody {
+    using value_type = std::shared_ptr<const std::string>;
+
+    static std::uint64_t size(const value_type& body) {
+        return body ? body->size() : 0;
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template <bool isRequest, typename Fields>
+        writer(const http::header<isRequest, Fields>&, const value_type& body) : body_(body) {}
+
+        void init(beast::error_code& ec) {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            if (!body_ || body_->empty()) {
+                return boost::none;
+            }
+            return {{net::const_buffer(body_->data(), body_->size()), false}};
+        }
+
+    private:
+        const value_type& body_;
+    };
+};
+
+// Тело из диапазона открытого файла. В Linux сессия отправляет его через sendfile
+// из page cache прямо в сокет, на других платформах — чтением кусками, как http::file_body
+struct FileRangeBody {
+    struct value_type {
+        beast::file file;
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+    };
+
+    static std::uint64_t size(const value_type& body) {
+        return body.size;
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template <bool isRequest, typename Fields>
+        writer(const http::header<isRequest, Fields>&, value_type& body) : body_(body) {}
+
+        void init(beast::error_code& ec) {
+            remain_ = body_.size;
+            body_.file.seek(body_.offset, ec);
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            const auto amount = static_cast<std::size_t>(std::min<std::uint64_t>(remain_, sizeof(buffer_)));
+            if (amount == 0) {
+                ec = {};
+                return boost::none;
+            }
+            const auto read = body_.file.read(buffer_, amount, ec);
+            if (ec) {
+                return boost::none;
+            }
+            if (read == 0) {
+                ec = http::error::short_read;
+                return boost::none;
+            }
+            remain_ -= read;
+            return {{net::const_buffer(buffer_, read), remain_ > 0}};
+        }
+
+    private:
+        static constexpr std::size_t BUFFER_SIZE = 64 * 1024;
+
+        value_type& body_;
+        std::uint64_t remain_ = 0;
+        char buffer_[BUFFER_SIZE];
+    };
+};
+
+// Получает соединение, запросившее переход на WebSocket, вместе с запросом на upgrade
+using UpgradeHandler = std::function<void(beast::tcp_stream&& stream, http::request<http::string_body>&& request)>;
+
+// Отвечает на запрос upgrade обычным HTTP-ответом и закрывает соединение
+void RejectUpgrade(beast::tcp_stream&& stream, http::response<http::string_body>&& response);
+
+// Соединение, перешедшее на WebSocket. Сервер только пишет в него кадры, входящие сообщения
+// читаются и отбрасываются, чтобы вовремя заметить закрытие.
+// Если клиент не успевает читать, ожидающий кадр вытесняется более свежим
+class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
+public:
+    using Frame = std::shared_ptr<const std::string>;
+    using HttpRequest = http::request<http::string_body>;
+
+    // Сколько кадров может ждать отправки помимо уже записываемого
+    static constexpr size_t MAX_PENDING_FRAMES = 1;
+
+    explicit WebSocketSession(beast::tcp_stream&& stream);
+
+    WebSocketSession(const WebSocketSession&) = delete;
+    WebSocketSession& operator=(const WebSocketSession&) = delete;
+
+    // Завершает рукопожатие по запросу на upgrade
+    void Run(HttpRequest&& request);
+
+    // Send и Close можно вызывать из любого потока
+    void Send(Frame frame);
+    void Close(websocket::close_reason reason = websocket::close_code::normal);
+    bool IsOpen() const { return open_; }
+
+private:
+    void OnAccept(beast::error_code ec);
+    void Read();
+    void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read);
+    void DoClose(websocket::close_reason reason);
+    void Enqueue(Frame frame);
+    void Write();
+    void OnWrite(beast::error_code ec, [[maybe_unused]] std::size_t bytes_written);
+
+    websocket::stream<beast::tcp_stream> ws_;
+    HttpRequest request_;
+    beast::flat_buffer buffer_;
+    // Первым лежит записываемый кадр, пока writing_
+    std::deque<Frame> queue_;
+    bool accepted_ = false;
+    bool writing_ = false;
+    std::atomic_bool open_ = true;
+};
+
 class SessionBase { 
 public:
     SessionBase(const SessionBase&) = delete;
@@ -37,6 +181,11 @@ protected:
 
     template <typename Body, typename Fields>
     void Write(http::response<Body, Fields>&& response) {
+#ifdef __linux__
+        if constexpr (std::is_same_v<Body, FileRangeBody> && std::is_same_v<Fields, http::fields>) {
+            return SendFile(std::move(response));
+        }
+#endif
         auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
 
         auto self = GetSharedThis();
@@ -56,6 +205,15 @@ private:
 
     void Close();
 
+#ifdef __linux__
+    // Столько байт отправляется за один заход, потом поток отдаётся другим соединениям
+    static constexpr std::size_t SENDFILE_BUDGET = 4 * 1024 * 1024;
+
+    struct SendFileState;
+    void SendFile(http::response<FileRangeBody>&& response);
+    void SendFileChunk(const std::shared_ptr<SendFileState>& state);
+#endif
+
     beast::flat_buffer buffer_;
     HttpRequest request_;
     virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
@@ -68,9 +226,10 @@ template <typename RequestHandler>
 class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
 public:
     template <typename Handler>
-    Session(tcp::socket&& socket, Handler&& request_handler)
+    Session(tcp::socket&& socket, Handler&& request_handler, UpgradeHandler upgrade_handler)
         : SessionBase(std::move(socket))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , upgrade_handler_(std::move(upgrade_handler)) {
     }
 private:
     std::shared_ptr<SessionBase> GetSharedThis() override {
@@ -78,22 +237,28 @@ private:
     }
 
     void HandleRequest(HttpRequest&& request) override {
+        if (upgrade_handler_ && websocket::is_upgrade(request)) {
+            // Дальше соединением владеет обработчик upgrade, HTTP-сессия на этом заканчивается
+            return upgrade_handler_(std::move(stream_), std::move(request));
+        }
         request_handler_(std::move(request), [self = this->shared_from_this()](auto&& response) {
             self->Write(std::move(response));
         }, stream_.socket().remote_endpoint());
     }
 
     RequestHandler request_handler_;
+    UpgradeHandler upgrade_handler_;
 };
 
 template <typename RequestHandler>
 class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
 public:
     template <typename Handler>
-    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler)
+    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler, UpgradeHandler upgrade_handler)
         : ioc_(ioc)
         , acceptor_(net::make_strand(ioc))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , upgrade_handler_(std::move(upgrade_handler)) {
         acceptor_.open(endpoint.protocol());
 
         acceptor_.set_option(net::socket_base::reuse_address(true));
@@ -125,19 +290,22 @@ private:
     }
 
     void AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_, upgrade_handler_)->Run();
     }
 
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     RequestHandler request_handler_;
+    UpgradeHandler upgrade_handler_;
 };
 
+// Без upgrade_handler запросы на WebSocket обрабатываются как обычные HTTP-запросы
 template <typename RequestHandler>
-void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler,
+               UpgradeHandler upgrade_handler = {}) {
     using MyListener = Listener<std::decay_t<RequestHandler>>;
 
-    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), std::move(upgrade_handler))->Run();
 }
 
 }  // namespace http_server
@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <chrono>
 #include <cstdint>
+#include <stdexcept>
 
 #include "loot_generator.h"
 
@@ -83,6 +84,14 @@ model::Game LoadGame(const std::filesystem::path& json_path, bool randomize_spaw
         game.AddDefaultBagCapacity(capacity);
     }
 
+    if (parsed_json.as_object().count("maxDogsPerSession")) {
+        int max_dogs = parsed_json.as_object().at("maxDogsPerSession").as_int64();
+        if (max_dogs <= 0) {
+            throw std::runtime_error("maxDogsPerSession должен быть положительным");
+        }
+        game.SetMaxDogsPerSession(max_dogs);
+    }
+
     if (parsed_json.as_object().count("dogRetirementTime")) {
         dog_retirement_time = parsed_json.as_object().at("dogRetirementTime").as_double();
     } else {
@@ -116,7 +125,7 @@ model::Game LoadGame(const std::filesystem::path& json_path, bool randomize_spaw
             map.AddBagCapacity(capacity);
         }
 
-        map.BuildRoadLookup();
+        map.BuildRoadGraph();
 
         game.AddMap(std::move(map));
     }
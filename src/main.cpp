@@ -5,6 +5,7 @@
 #include <boost/program_options.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <iostream>
 #include <thread>
 #include <fstream>
@@ -35,6 +36,8 @@ struct Args {
     bool randomize_spawn_points = false;
     std::filesystem::path state_file;
     std::optional<int> save_state_period;
+    std::optional<uint64_t> seed;
+    uintmax_t sendfile_threshold = http_handler::StaticFiles::DEFAULT_SENDFILE_THRESHOLD;
 };
 
 [[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
@@ -50,7 +53,10 @@ struct Args {
         ("www-root,w", po::value(&args.www_root)->required()->value_name("dir"), "set static files root")
         ("randomize-spawn-points", po::bool_switch(&args.randomize_spawn_points), "spawn dogs at random positions")
         ("state-file,s", po::value(&args.state_file)->value_name("file"), "set state file path")
-        ("save-state-period,p", po::value<int>()->value_name("milliseconds"), "set state save period");
+        ("save-state-period,p", po::value<int>()->value_name("milliseconds"), "set state save period")
+        ("seed", po::value<uint64_t>()->value_name("number"), "make spawning, tokens and tick deltas reproducible")
+        ("sendfile-threshold", po::value(&args.sendfile_threshold)->value_name("bytes"),
+            "send static files larger than this with sendfile, keep smaller ones in memory");
 
         
         
@@ -84,6 +90,10 @@ struct Args {
         }
     }
 
+    if (vm.contains("seed")) {
+        args.seed = vm["seed"].as<uint64_t>();
+    }
+
     return args;
 }
 
@@ -129,6 +139,9 @@ int main(int argc, const char* argv[]) {
         ExtraData ex_data;
         double dog_retirement_time = 0.0;
         model::Game game = json_loader::LoadGame(args->config_file, args->randomize_spawn_points, ex_data, dog_retirement_time);
+        if (args->seed) {
+            game.SetRandomSeed(*args->seed);
+        }
         app::Application app(game, ex_data, db_handler, dog_retirement_time);
 
         auto save_period = args->save_state_period.value_or(0);
@@ -155,31 +168,52 @@ int main(int argc, const char* argv[]) {
 
         auto api_strand = net::make_strand(ioc);
 
+        // Тик со своими параллельными задачами идёт на отдельном пуле:
+        // ему не нужно ждать свободного потока io_context, а запросам — конца тика
+        net::thread_pool tick_pool(std::max(1u, num_threads));
+        app.SetTickExecutor({tick_pool.get_executor(), std::max(1u, num_threads)});
+
         //Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
         net::signal_set signals(ioc, SIGINT, SIGTERM);
-        signals.async_wait([&ioc, &serializer](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+        signals.async_wait([&ioc, &app, &serializer](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
             if (!ec) {
-                ioc.stop();
-                serializer->OnShutdown();
+                // Состояние сохраняется, когда его не меняют ни тик, ни запросы игроков
+                app.GetSessionsGate().AsyncExclusive(ioc.get_executor(), [&ioc, &app, &serializer](auto /*pass*/) {
+                    serializer->OnShutdown();
+                    app.GetSessionsGate().Close();
+                    ioc.stop();
+                });
             }
         });
 
         if(args->tick_period) {
-            auto ticker = std::make_shared<Ticker>(api_strand, std::chrono::milliseconds(args->tick_period.value()),
-                [&app](std::chrono::milliseconds delta) { app.Tick(delta); }
+            const std::chrono::milliseconds period{args->tick_period.value()};
+            // С seed тик длится ровно period, иначе delta зависела бы от загрузки машины
+            Ticker::TickClock clock = [] { return std::chrono::steady_clock::now(); };
+            if (args->seed) {
+                clock = FixedStepClock{period};
+            }
+            auto ticker = std::make_shared<Ticker>(api_strand, period,
+                [&app, &tick_pool](std::chrono::milliseconds delta, Ticker::Done done) {
+                    app.AsyncTick(tick_pool.get_executor(), delta, std::move(done));
+                },
+                std::move(clock)
             );
             ticker->Start();
         }
 
         //Создаём обработчик HTTP-запросов и связываем его с моделью игры
         auto handler = std::make_shared<http_handler::RequestHandler>(api_strand, game, args->www_root.c_str(), 
-        app, args->tick_period, ex_data);
+        app, args->tick_period, ex_data, args->sendfile_threshold);
+        app.AddListener(handler->GetStatePublisher());
 
         //Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
         const auto address = net::ip::make_address("0.0.0.0");
         constexpr net::ip::port_type port = 8080;
         http_server::ServeHttp(ioc, {address, port}, [handler](auto&& req, auto&& send, auto&& endpoint) {
             (*handler)(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send), std::forward<decltype(endpoint)>(endpoint));
+        }, [handler](beast::tcp_stream&& stream, StringRequest&& req) {
+            handler->HandleUpgrade(std::move(stream), std::move(req));
         });
 
         //Логируем старт сервера
@@ -190,6 +224,8 @@ int main(int argc, const char* argv[]) {
         RunWorkers(std::max(1u, num_threads), [&ioc] {
             ioc.run();
         });
+        // Ожидающие доступа обработчики держат сокеты и таймеры, они уничтожаются раньше io_context
+        app.GetSessionsGate().Close();
     } catch (const std::exception& ex) {
         std::map<std::string, std::string> data{
             {"code", std::to_string(EXIT_FAILURE)},
@@ -0,0 +1,25 @@
+#include "map_responses.h"
+#include "json_utils.h"
+
+#include <boost/json.hpp>
+
+namespace http_handler {
+
+MapResponses::MapResponses(app::Application& app, const ExtraData& ex_data) {
+    boost::json::array maps_json;
+    for (const auto& map_data : app.GetMapsScenario()->Execute()) {
+        maps_json.push_back(boost::json::object{{"id", map_data.id}, {"name", map_data.name}});
+
+        auto map_json = json_utils::MapToJson(*app.GetMapByIdScenario()->Execute(map_data.id));
+        map_json["lootTypes"] = ex_data.GetLootsForMap(map_data.id);
+        maps_.emplace(map_data.id, MakeCachedBody(boost::json::serialize(map_json)));
+    }
+    list_ = MakeCachedBody(boost::json::serialize(maps_json));
+}
+
+const CachedBody* MapResponses::FindMap(std::string_view id) const {
+    auto it = maps_.find(id);
+    return it == maps_.end() ? nullptr : &it->second;
+}
+
+}  // namespace http_handler
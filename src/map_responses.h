@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "application.h"
+#include "extra_data.h"
+#include "http_cache.h"
+
+namespace http_handler {
+
+// Тела ответов /api/v1/maps и /api/v1/maps/{id}. Карты после загрузки не меняются,
+// поэтому JSON собирается один раз при старте и дальше отдаётся готовым
+class MapResponses {
+public:
+    MapResponses(app::Application& app, const ExtraData& ex_data);
+
+    const CachedBody& GetList() const { return list_; }
+    // nullptr, если карты нет
+    const CachedBody* FindMap(std::string_view id) const;
+
+private:
+    struct IdHasher {
+        using is_transparent = void;
+        size_t operator()(std::string_view id) const noexcept { return std::hash<std::string_view>{}(id); }
+    };
+
+    CachedBody list_;
+    std::unordered_map<std::string, CachedBody, IdHasher, std::equal_to<>> maps_;
+};
+
+}  // namespace http_handler
@@ -1,8 +1,11 @@
 #include "model.h"
 
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <map>
 #include <cstdlib>
-#include <ctime>
 
 namespace model {
 using namespace std::literals;
@@ -74,62 +77,343 @@ std::optional<Direction> StringToDirection(const std::string& str) {
     throw std::invalid_argument("Invalid direction string");
 }
 
-void Map::BuildRoadLookup() {
-    for (const auto& road : roads_) {
-        if (road.IsHorizontal()) {
-            for (double x = road.GetStart().x; x <= road.GetEnd().x; x += 0.5) {
-                road_lookup_[{x, static_cast<double>(road.GetStart().y)}].push_back(std::make_shared<Road>(road));
-            }
-        } else if (road.IsVertical()) {
-            for (double y = road.GetStart().y; y <= road.GetEnd().y; y += 0.5) {
-                road_lookup_[{static_cast<double>(road.GetStart().x), y}].push_back(std::make_shared<Road>(road));
-            }
-        }
+namespace {
+
+constexpr double WIDTH_ROAD = 0.4;
+
+void InsertSpan(std::vector<Map::RoadSpan>& spans, Map::RoadSpan span) {
+    auto it = std::lower_bound(spans.begin(), spans.end(), span.min,
+        [](const Map::RoadSpan& lhs, Coord value) { return lhs.min < value; });
+
+    // Сливаем новый отрезок с соседями, которые его касаются или перекрывают
+    if (it != spans.begin() && std::prev(it)->max >= span.min) {
+        --it;
+        span.min = it->min;
+        span.max = std::max(span.max, it->max);
+        it = spans.erase(it);
     }
+    while (it != spans.end() && it->min <= span.max) {
+        span.max = std::max(span.max, it->max);
+        it = spans.erase(it);
+    }
+    spans.insert(it, span);
 }
 
-bool Map::IsOnRoad(const Position& pos) {
-    constexpr double WIDTH_ROAD = 0.4;
-    const double epsilon = std::numeric_limits<double>::epsilon();
+// Края полосы дороги вдоль линии coord. Сравнения ведутся именно с этими значениями,
+// чтобы точка, остановленная на краю дороги, оставалась на дороге
+double LowerEdge(Coord coord) {
+    return coord - WIDTH_ROAD;
+}
 
-    for (const auto& road : roads_) {
-        if (road.IsHorizontal()) {
-            const double road_y = static_cast<double>(road.GetStart().y);
-            if (std::abs(pos.y - road_y) > WIDTH_ROAD + epsilon) continue;
+double UpperEdge(Coord coord) {
+    return coord + WIDTH_ROAD;
+}
 
-            const double road_x1 = static_cast<double>(road.GetStart().x);
-            const double road_x2 = static_cast<double>(road.GetEnd().x);
-            const double min_x = std::min(road_x1, road_x2) - WIDTH_ROAD - epsilon;
-            const double max_x = std::max(road_x1, road_x2) + WIDTH_ROAD + epsilon;
+struct SpanHit {
+    Coord line;
+    Map::RoadSpan span;
+};
 
-            if (pos.x >= min_x - epsilon && pos.x <= max_x + epsilon) {
-                return true;
-            }
+std::optional<SpanHit> FindSpan(const Map::RoadSpans& lines, double line_pos, double along_pos) {
+    const Coord line = static_cast<Coord>(std::round(line_pos));
+    if (line_pos < LowerEdge(line) || line_pos > UpperEdge(line)) {
+        return std::nullopt;
+    }
+
+    auto lines_it = lines.find(line);
+    if (lines_it == lines.end()) {
+        return std::nullopt;
+    }
+
+    // Расширенные на ширину дороги отрезки не пересекаются, поэтому достаточно
+    // проверить последний отрезок, начинающийся не правее точки
+    const auto& spans = lines_it->second;
+    auto it = std::upper_bound(spans.begin(), spans.end(), along_pos,
+        [](double value, const Map::RoadSpan& rhs) { return value < LowerEdge(rhs.min); });
+    if (it == spans.begin() || along_pos > UpperEdge(std::prev(it)->max)) {
+        return std::nullopt;
+    }
+    return SpanHit{line, *std::prev(it)};
+}
+
+// Отрезок оси движения, покрытый объединением дорог, на которых стоит точка.
+// line_pos — координата точки поперёк движения, along_pos — вдоль движения
+std::optional<std::pair<double, double>> GetReachableRange(const Map::RoadSpans& along_lines,
+    const Map::RoadSpans& across_lines, double line_pos, double along_pos) {
+    std::optional<std::pair<double, double>> range;
+    const auto extend = [&range](double low, double high) {
+        if (!range) {
+            range.emplace(low, high);
         } else {
-            const double road_x = static_cast<double>(road.GetStart().x);
-            if (std::abs(pos.x - road_x) > WIDTH_ROAD + epsilon) continue;
+            range->first = std::min(range->first, low);
+            range->second = std::max(range->second, high);
+        }
+    };
+
+    if (auto hit = FindSpan(along_lines, line_pos, along_pos)) {
+        extend(LowerEdge(hit->span.min), UpperEdge(hit->span.max));
+    }
+    if (auto hit = FindSpan(across_lines, along_pos, line_pos)) {
+        extend(LowerEdge(hit->line), UpperEdge(hit->line));
+    }
+    return range;
+}
 
-            const double road_y1 = static_cast<double>(road.GetStart().y);
-            const double road_y2 = static_cast<double>(road.GetEnd().y);
-            const double min_y = std::min(road_y1, road_y2) - WIDTH_ROAD - epsilon;
-            const double max_y = std::max(road_y1, road_y2) + WIDTH_ROAD + epsilon;
+uint64_t MakeEpoch() {
+    std::random_device device;
+    const uint64_t epoch = (uint64_t{device()} << 32) ^ device();
+    return epoch & ((uint64_t{1} << 53) - 1);
+}
 
-            if (pos.y >= min_y - epsilon && pos.y <= max_y + epsilon) {
-                return true;
+// Выбирается при запуске и не зависит от seed игры: иначе воспроизводимый прогон после перезапуска
+// получил бы ту же эпоху, и клиенты приняли бы новые номера тиков за старые
+const uint64_t EPOCH = MakeEpoch();
+
+}  // namespace
+
+void Map::IndexRoad(const Road& road) {
+    const Point start = road.GetStart();
+    const Point end = road.GetEnd();
+    if (road.IsHorizontal()) {
+        InsertSpan(horizontal_spans_[start.y], {std::min(start.x, end.x), std::max(start.x, end.x)});
+    } else {
+        InsertSpan(vertical_spans_[start.x], {std::min(start.y, end.y), std::max(start.y, end.y)});
+    }
+
+    const double length = std::abs(end.x - start.x) + std::abs(end.y - start.y);
+    road_length_prefix_.push_back(GetTotalRoadLength() + length);
+}
+
+Position Map::GetPositionAtRoadDistance(double distance) const {
+    if (roads_.empty()) {
+        return {0.0, 0.0};
+    }
+
+    // Дороги нулевой длины не увеличивают сумму, поэтому upper_bound их пропускает
+    auto it = std::upper_bound(road_length_prefix_.begin(), road_length_prefix_.end(), distance);
+    if (it == road_length_prefix_.end()) {
+        --it;
+    }
+    const size_t index = it - road_length_prefix_.begin();
+    const double road_begin = index == 0 ? 0.0 : road_length_prefix_[index - 1];
+
+    const Road& road = roads_[index];
+    const Point start = road.GetStart();
+    const Point end = road.GetEnd();
+    const double offset = std::clamp(distance - road_begin, 0.0, *it - road_begin);
+    if (road.IsHorizontal()) {
+        return {start.x + (end.x >= start.x ? offset : -offset), static_cast<double>(start.y)};
+    }
+    return {static_cast<double>(start.x), start.y + (end.y >= start.y ? offset : -offset)};
+}
+
+bool Map::IsOnRoad(const Position& pos) const {
+    return FindSpan(horizontal_spans_, pos.y, pos.x) || FindSpan(vertical_spans_, pos.x, pos.y);
+}
+
+Position Map::MoveAlongRoads(Position from, Position to) const {
+    if (from.y == to.y) {
+        auto range = GetReachableRange(horizontal_spans_, vertical_spans_, from.y, from.x);
+        if (!range) {
+            return from;
+        }
+        return {std::clamp(to.x, range->first, range->second), from.y};
+    }
+
+    auto range = GetReachableRange(vertical_spans_, horizontal_spans_, from.x, from.y);
+    if (!range) {
+        return from;
+    }
+    return {from.x, std::clamp(to.y, range->first, range->second)};
+}
+
+RoadGraph::RoadGraph(const std::vector<Road>& roads) {
+    // Дороги, сгруппированные по линии: горизонтальные по y, вертикальные по x
+    std::map<Coord, std::vector<size_t>> horizontal;
+    std::map<Coord, std::vector<size_t>> vertical;
+    for (size_t i = 0; i < roads.size(); ++i) {
+        if (roads[i].IsHorizontal()) {
+            horizontal[roads[i].GetStart().y].push_back(i);
+        } else {
+            vertical[roads[i].GetStart().x].push_back(i);
+        }
+    }
+
+    const auto range_of = [](Coord a, Coord b) {
+        return std::pair{std::min(a, b), std::max(a, b)};
+    };
+
+    // Вершины на дороге: её концы, концы соосных дорог и пересечения с перпендикулярными
+    const auto collect_stops = [&roads, &range_of](Coord line, Coord low, Coord high,
+                                                   const std::map<Coord, std::vector<size_t>>& same,
+                                                   const std::map<Coord, std::vector<size_t>>& across,
+                                                   bool horizontal_road) {
+        std::vector<Coord> stops{low, high};
+        const auto along = [horizontal_road](Point p) { return horizontal_road ? p.x : p.y; };
+        const auto across_line = [horizontal_road](Point p) { return horizontal_road ? p.y : p.x; };
+
+        for (size_t other : same.at(line)) {
+            for (Point end : {roads[other].GetStart(), roads[other].GetEnd()}) {
+                if (along(end) >= low && along(end) <= high) {
+                    stops.push_back(along(end));
+                }
             }
         }
+        for (auto it = across.lower_bound(low); it != across.end() && it->first <= high; ++it) {
+            for (size_t other : it->second) {
+                auto [other_low, other_high] = range_of(across_line(roads[other].GetStart()),
+                                                        across_line(roads[other].GetEnd()));
+                if (line >= other_low && line <= other_high) {
+                    stops.push_back(it->first);
+                }
+            }
+        }
+
+        std::sort(stops.begin(), stops.end());
+        stops.erase(std::unique(stops.begin(), stops.end()), stops.end());
+        return stops;
+    };
+
+    std::vector<std::pair<NodeId, EdgeId>> incidence;
+    for (size_t i = 0; i < roads.size(); ++i) {
+        const Road& road = roads[i];
+        const bool is_horizontal = road.IsHorizontal();
+        const Coord line = is_horizontal ? road.GetStart().y : road.GetStart().x;
+        auto [low, high] = is_horizontal ? range_of(road.GetStart().x, road.GetEnd().x)
+                                         : range_of(road.GetStart().y, road.GetEnd().y);
+
+        const auto to_point = [is_horizontal, line](Coord value) {
+            return is_horizontal ? Point{value, line} : Point{line, value};
+        };
+
+        auto stops = is_horizontal ? collect_stops(line, low, high, horizontal, vertical, true)
+                                   : collect_stops(line, low, high, vertical, horizontal, false);
+
+        NodeId prev = AddNode(to_point(stops.front()));
+        for (size_t s = 1; s < stops.size(); ++s) {
+            NodeId next = AddNode(to_point(stops[s]));
+            const EdgeId edge = edges_.size();
+            edges_.push_back({i, prev, next});
+            incidence.emplace_back(prev, edge);
+            incidence.emplace_back(next, edge);
+            prev = next;
+        }
+    }
+
+    // Списки смежности в формате CSR: рёбра вершины v лежат в adjacency_[offsets[v], offsets[v + 1])
+    std::sort(incidence.begin(), incidence.end());
+    adjacency_offsets_.assign(nodes_.size() + 1, 0);
+    adjacency_.reserve(incidence.size());
+    for (auto [node, edge] : incidence) {
+        ++adjacency_offsets_[node + 1];
+        adjacency_.push_back(edge);
+    }
+    for (size_t n = 0; n < nodes_.size(); ++n) {
+        adjacency_offsets_[n + 1] += adjacency_offsets_[n];
     }
-    return false;
 }
 
-std::vector<std::shared_ptr<Road>> Map::GetRoadsAt(Position pos) const {
-    if (auto it = road_lookup_.find(pos); it != road_lookup_.end()) {
+RoadGraph::NodeId RoadGraph::AddNode(Point point) {
+    auto [it, inserted] = node_by_point_.emplace(MakeKey(point), nodes_.size());
+    if (inserted) {
+        nodes_.push_back(point);
+    }
+    return it->second;
+}
+
+std::optional<RoadGraph::NodeId> RoadGraph::FindNode(Point point) const {
+    if (auto it = node_by_point_.find(MakeKey(point)); it != node_by_point_.end()) {
         return it->second;
     }
-    return {};
+    return std::nullopt;
+}
+
+std::vector<size_t> RoadGraph::GetRoadsAt(Point point) const {
+    std::vector<size_t> result;
+    if (auto node = FindNode(point)) {
+        for (EdgeId edge : GetNodeEdges(*node)) {
+            result.push_back(edges_[edge].road);
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    }
+    return result;
 }
 
-std::shared_ptr<Dog> GameSession::AddDog(const std::string& name, int bag_capacity) {
+void Map::BuildRoadGraph() {
+    road_graph_ = std::make_shared<const RoadGraph>(roads_);
+}
+
+std::optional<size_t> DogStore::Find(DogHandle dog) const {
+    if (auto it = index_by_id_.find(dog.id); it != index_by_id_.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+size_t DogStore::Add(Dog dog) {
+    if (index_by_id_.contains(dog.GetId())) {
+        throw std::invalid_argument("Duplicate dog id");
+    }
+    const size_t index = ids_.size();
+    ids_.push_back(dog.GetId());
+    names_.push_back(dog.GetName());
+    positions_.push_back(dog.GetPosition());
+    velocities_.push_back(dog.GetVelocity());
+    directions_.push_back(dog.GetDirection());
+    points_.push_back(dog.GetPoints());
+    join_times_ms_.push_back(dog.GetJoinTimeMs());
+    inactive_times_ms_.push_back(dog.GetInactiveTimeMs());
+    bags_.push_back(std::move(dog.GetBag()));
+    change_ticks_.push_back(change_tick_);
+    index_by_id_.emplace(dog.GetId(), index);
+    return index;
+}
+
+void DogStore::Remove(DogHandle dog) {
+    auto it = index_by_id_.find(dog.id);
+    if (it == index_by_id_.end()) {
+        return;
+    }
+    const size_t index = it->second;
+    const size_t last = ids_.size() - 1;
+    index_by_id_.erase(it);
+
+    if (index != last) {
+        ids_[index] = ids_[last];
+        names_[index] = std::move(names_[last]);
+        positions_[index] = positions_[last];
+        velocities_[index] = velocities_[last];
+        directions_[index] = directions_[last];
+        points_[index] = points_[last];
+        join_times_ms_[index] = join_times_ms_[last];
+        inactive_times_ms_[index] = inactive_times_ms_[last];
+        bags_[index] = std::move(bags_[last]);
+        change_ticks_[index] = change_ticks_[last];
+        index_by_id_[ids_[index]] = index;
+    }
+
+    ids_.pop_back();
+    names_.pop_back();
+    positions_.pop_back();
+    velocities_.pop_back();
+    directions_.pop_back();
+    points_.pop_back();
+    join_times_ms_.pop_back();
+    inactive_times_ms_.pop_back();
+    bags_.pop_back();
+    change_ticks_.pop_back();
+}
+
+Dog DogStore::Get(size_t index) const {
+    Dog dog(names_[index], ids_[index], bags_[index].GetCapacity(), positions_[index], velocities_[index], directions_[index]);
+    dog.GetBag() = bags_[index];
+    dog.AddPoints(points_[index]);
+    dog.SetTimes(join_times_ms_[index], inactive_times_ms_[index]);
+    return dog;
+}
+
+DogHandle GameSession::AddDog(const std::string& name, int bag_capacity) {
     Position position;
     if(randomize_spawn_points_) {
         position = GetRandomPositionOnRoad();
@@ -138,56 +422,89 @@ std::shared_ptr<Dog> GameSession::AddDog(const std::string& name, int bag_capaci
         position = {static_cast<double>(point.x), static_cast<double>(point.y)};
     }
 
-    auto new_dog = std::make_shared<Dog>(name, next_id_dog_, bag_capacity, position);
-    if (!new_dog) {
-        std::cerr << "Error: failed to create a dog!" << std::endl;
-        return nullptr;
-    }
-    dogs_[next_id_dog_++] = new_dog;
-    return new_dog;
+    const DogHandle handle{next_id_dog_++};
+    dogs_.Add(Dog(name, handle.id, bag_capacity, position));
+    MarkChanged();
+    return handle;
 }
 
 void GameSession::AddLoots (int num) {
-    srand(time(NULL));
     int maxNumber = map_->GetNumLoots();
+    if (maxNumber <= 0 || num <= 0) {
+        return;
+    }
+    MarkChanged();
 
     for(int i = 0; i < num; ++i) {
-        int randomNumber = rand() % maxNumber;
+        int randomNumber = static_cast<int>(random_.NextBelow(maxNumber));
         Position pos = GetRandomPositionOnRoad();
     
-        auto loot = std::make_shared<Loot>(randomNumber, pos, next_id_loot_);
-
-        loots_[next_id_loot_++] = loot;
+        Loot loot(randomNumber, pos, next_id_loot_++);
+        loot.SetAddedTick(tick_ + 1);
+        loots_.Insert(std::move(loot));
     }
 
 }
 
 Position GameSession::GetRandomPositionOnRoad() {
-    if (map_->GetRoads().empty()) {
+    const auto& roads = map_->GetRoads();
+    if (roads.empty()) {
         return {0.0, 0.0};
     }
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    const auto& roads = map_->GetRoads();
-    std::uniform_int_distribution<size_t> road_dist(0, roads.size() - 1);
-    const auto& road = roads[road_dist(gen)];
+    const double total_length = map_->GetTotalRoadLength();
+    if (total_length == 0.0) {
+        // Все дороги — точки, длина не различает их
+        const Point point = roads[random_.NextBelow(roads.size())].GetStart();
+        return {static_cast<double>(point.x), static_cast<double>(point.y)};
+    }
+    return map_->GetPositionAtRoadDistance(random_.NextDouble() * total_length);
+}
 
-    if (road.IsHorizontal()) {
-        std::uniform_real_distribution<double> x_dist(road.GetStart().x, road.GetEnd().x);
-        return {x_dist(gen), static_cast<double>(road.GetStart().y)};
-    } else {
-        std::uniform_real_distribution<double> y_dist(road.GetStart().y, road.GetEnd().y);
-        return {static_cast<double>(road.GetStart().x), y_dist(gen)};
+bool GameSession::RemoveLoot(LootKey key) {
+    const Loot* loot = loots_.Find(key);
+    if (!loot) {
+        return false;
     }
+    MarkChanged();
+    removed_loots_.push_back({tick_ + 1, loot->GetId()});
+    return loots_.Remove(key);
 }
 
-const std::shared_ptr<Dog> GameSession::GetDog(uint32_t id) const {
-    auto it = dogs_.find(id);
-    if (it != dogs_.end()) {
-        return it->second;
+void GameSession::RemoveDog(DogHandle dog) {
+    if (!dogs_.Find(dog)) {
+        return;
     }
-    return nullptr;
+    MarkChanged();
+    removed_dogs_.push_back({tick_ + 1, dog.id});
+    dogs_.Remove(dog);
+}
+
+uint64_t GameSession::GetEpoch() noexcept {
+    return EPOCH;
+}
+
+void GameSession::FinishTick() {
+    ++tick_;
+    dogs_.SetChangeTick(tick_ + 1);
+
+    // Удаления идут по возрастанию тика, устаревшие лежат в начале. Удаление после тика r
+    // нужно только клиентам с since < r, а since старше tick_ - DELTA_HISTORY_TICKS не принимается
+    const auto forget = [this](std::vector<Removal>& removals) {
+        auto first_kept = std::find_if(removals.begin(), removals.end(), [this](const Removal& removal) {
+            return removal.tick + DELTA_HISTORY_TICKS > tick_;
+        });
+        removals.erase(removals.begin(), first_kept);
+    };
+    forget(removed_dogs_);
+    forget(removed_loots_);
+}
+
+std::optional<DogRef> GameSession::GetDog(DogHandle dog) {
+    if (auto index = dogs_.Find(dog)) {
+        return DogRef(dogs_, *index);
+    }
+    return std::nullopt;
 }
 
 const Map* Game::FindMap(const Map::Id& id) const noexcept {
@@ -198,16 +515,46 @@ const Map* Game::FindMap(const Map::Id& id) const noexcept {
 }
 
 std::shared_ptr<GameSession> Game::GetSession(const Map::Id& id) {
-    auto it = sessions_.find(id);
-    if (it != sessions_.end()) {
-        return it->second;
+    const Map* map = FindMap(id);
+    if (!map) {
+        return nullptr;
     }
-    std::shared_ptr<model::Map> mapPtr = std::make_shared<model::Map>(*FindMap(id));
-    auto session = std::make_shared<GameSession>(mapPtr, randomize_spawn_points_);
-    sessions_[id] = session;
+
+    auto& instances = sessions_[id];
+    std::shared_ptr<GameSession> least_loaded;
+    for (const auto& session : instances) {
+        const size_t dogs = session->GetDogs().Size();
+        if (max_dogs_per_session_ && dogs >= *max_dogs_per_session_) {
+            continue;
+        }
+        if (!least_loaded || dogs < least_loaded->GetDogs().Size()) {
+            least_loaded = session;
+        }
+    }
+    if (least_loaded) {
+        return least_loaded;
+    }
+
+    // Экземпляры одной карты делят её копию
+    std::shared_ptr<model::Map> mapPtr = instances.empty() ? std::make_shared<model::Map>(*map) : instances.front()->GetMap();
+    auto session = std::make_shared<GameSession>(mapPtr, randomize_spawn_points_, instances.size(),
+                                                 MakeSessionSeed(id, instances.size()));
+    instances.push_back(session);
     return session;
 }
 
+uint64_t Game::MakeSessionSeed(const Map::Id& id, size_t instance) const {
+    return random_seed_ ? util::DeriveSeed(*random_seed_, *id, instance) : util::RandomSeed();
+}
+
+std::shared_ptr<GameSession> Game::FindSession(const Map::Id& id, size_t instance) const {
+    auto it = sessions_.find(id);
+    if (it == sessions_.end() || instance >= it->second.size()) {
+        return nullptr;
+    }
+    return it->second[instance];
+}
+
 double Game::GetDefaultDogSpeed(const Map::Id& id) const noexcept {
     auto map = FindMap(id);
     auto speed = map->GetDogSpeed();
@@ -13,8 +13,14 @@
 #include <iostream>
 #include <limits>
 #include <chrono>
+#include <span>
+#include <array>
+#include <algorithm>
+#include <stdexcept>
 
 #include "tagged.h"
+#include "slot_map.h"
+#include "random.h"
 #include "loot_generator.h"
 #include "collision_detector.h"
 
@@ -114,6 +120,54 @@ private:
     Point end_;
 };
 
+// Граф связности дорог карты. Вершины — концы дорог и их пересечения,
+// рёбра — участки дорог между соседними вершинами (с индексом дороги в Map::Roads).
+// Нужен для поиска путей. Движение и появление на дорогах его не используют:
+// им хватает отрезков по линиям и префиксных длин дорог в Map
+class RoadGraph {
+public:
+    using NodeId = size_t;
+    using EdgeId = size_t;
+
+    struct Edge {
+        size_t road;
+        NodeId from;
+        NodeId to;
+    };
+
+    RoadGraph() = default;
+    explicit RoadGraph(const std::vector<Road>& roads);
+
+    size_t GetNodeCount() const noexcept { return nodes_.size(); }
+    size_t GetEdgeCount() const noexcept { return edges_.size(); }
+
+    Point GetNode(NodeId id) const { return nodes_[id]; }
+    const Edge& GetEdge(EdgeId id) const { return edges_[id]; }
+
+    // Рёбра, инцидентные вершине
+    std::span<const EdgeId> GetNodeEdges(NodeId id) const {
+        return {adjacency_.data() + adjacency_offsets_[id], adjacency_.data() + adjacency_offsets_[id + 1]};
+    }
+
+    std::optional<NodeId> FindNode(Point point) const;
+
+    // Индексы дорог, проходящих через вершину в точке point
+    std::vector<size_t> GetRoadsAt(Point point) const;
+
+private:
+    static uint64_t MakeKey(Point point) noexcept {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(point.x)) << 32) | static_cast<uint32_t>(point.y);
+    }
+
+    NodeId AddNode(Point point);
+
+    std::vector<Point> nodes_;
+    std::vector<Edge> edges_;
+    std::vector<size_t> adjacency_offsets_;
+    std::vector<EdgeId> adjacency_;
+    std::unordered_map<uint64_t, NodeId> node_by_point_;
+};
+
 class Building {
 public:
     explicit Building(Rectangle bounds) noexcept
@@ -162,7 +216,13 @@ public:
     using Roads = std::vector<Road>;
     using Buildings = std::vector<Building>;
     using Offices = std::vector<Office>;
-    using RoadLookup = std::unordered_map<Position, std::vector<std::shared_ptr<Road>>, PositionHasher>;
+
+    // Объединённый отрезок дорог, лежащих на одной линии (x или y фиксирован)
+    struct RoadSpan {
+        Coord min, max;
+    };
+    // Ключ — координата линии, значение — непересекающиеся отрезки, отсортированные по min
+    using RoadSpans = std::unordered_map<Coord, std::vector<RoadSpan>>;
 
     Map(Id id, std::string name, int num_loots) noexcept
         : id_(std::move(id))
@@ -200,6 +260,7 @@ public:
 
     void AddRoad(const Road& road) {
         roads_.emplace_back(road);
+        IndexRoad(road);
     }
 
     void AddBuilding(const Building& building) {
@@ -216,16 +277,33 @@ public:
         bag_capacity_ = capacity;
     }
 
-    void BuildRoadLookup();
+    // Строит граф связности дорог для поиска путей. Граф неизменяем и разделяется между копиями карты
+    void BuildRoadGraph();
 
-    bool IsOnRoad(const Position& pos);
+    const RoadGraph& GetRoadGraph() const noexcept {
+        return *road_graph_;
+    }
+
+    bool IsOnRoad(const Position& pos) const;
+
+    // Перемещение вдоль одной из осей из from в сторону to. Возвращает самую дальнюю точку,
+    // достижимую в пределах объединения дорог, на которых находится from
+    Position MoveAlongRoads(Position from, Position to) const;
+
+    double GetTotalRoadLength() const noexcept {
+        return road_length_prefix_.empty() ? 0.0 : road_length_prefix_.back();
+    }
+
+    // Точка на расстоянии distance от начала, если выложить дороги карты одну за другой.
+    // Равномерный distance из [0, GetTotalRoadLength()) даёт точку, равномерную по длине дорог
+    Position GetPositionAtRoadDistance(double distance) const;
 
     int GetNumLoots() const { return num_loots_; }
 
 private:
     using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
 
-    std::vector<std::shared_ptr<Road>> GetRoadsAt(Position pos) const;
+    void IndexRoad(const Road& road);
 
     Id id_;
     std::string name_;
@@ -238,38 +316,78 @@ private:
     std::optional<double> dog_speed_;
     std::optional<int> bag_capacity_;
 
-    RoadLookup road_lookup_;
+    std::shared_ptr<const RoadGraph> road_graph_ = std::make_shared<const RoadGraph>();
+    RoadSpans horizontal_spans_;
+    RoadSpans vertical_spans_;
+    // road_length_prefix_[i] — суммарная длина дорог с 0 по i включительно
+    std::vector<double> road_length_prefix_;
 
     int num_loots_;
 };
 
+// Сколько предметов рюкзак хранит внутри себя, без выделения памяти
+#ifndef MODEL_BAG_INLINE_CAPACITY
+#define MODEL_BAG_INLINE_CAPACITY 8
+#endif
+
+struct BagItem {
+    int id;
+    int type;
+};
+
+// Рюкзак вместимостью до INLINE_CAPACITY живёт целиком внутри объекта.
+// Для большей вместимости память выделяется один раз в конструкторе.
 class Bag {
     public:
-        explicit Bag(int capacity) : capacity_(capacity) {}
+        static constexpr size_t INLINE_CAPACITY = MODEL_BAG_INLINE_CAPACITY;
+
+        explicit Bag(int capacity) : capacity_(std::max(capacity, 0)) {
+            if (!IsInline()) {
+                overflow_.reserve(capacity_);
+            }
+        }
     
         void AddItem(int id, int type) {
-            if (items_.size() >= capacity_) {
-                throw "Bag full";
+            if (IsFull()) {
+                throw std::length_error("Bag full");
+            }
+            if (IsInline()) {
+                inline_[size_] = BagItem{id, type};
+            } else {
+                overflow_.push_back(BagItem{id, type});
             }
-            items_[id] = type;
+            ++size_;
         }
 
-        void Clear() {
-            items_.clear();
+        void Clear() noexcept {
+            size_ = 0;
+            overflow_.clear();
         }
-        bool IsFull() const {
-            return items_.size() >= capacity_;
+        bool IsFull() const noexcept {
+            return size_ >= static_cast<size_t>(capacity_);
         }
-        int GetCapacity() const {
+        int GetCapacity() const noexcept {
             return capacity_;
         }
-        std::unordered_map<int, int> GetItems() const {
-            return items_;
+        size_t GetSize() const noexcept {
+            return size_;
+        }
+        std::span<const BagItem> GetItems() const noexcept {
+            if (IsInline()) {
+                return {inline_.data(), size_};
+            }
+            return overflow_;
         }
     
     private:
+        bool IsInline() const noexcept {
+            return static_cast<size_t>(capacity_) <= INLINE_CAPACITY;
+        }
+
         int capacity_;
-        std::unordered_map<int, int> items_;
+        size_t size_ = 0;
+        std::array<BagItem, INLINE_CAPACITY> inline_{};
+        std::vector<BagItem> overflow_;
     };
 
 class Dog {
@@ -307,6 +425,11 @@ class Dog {
 
         int64_t GetJoinTimeMs() const { return join_time_ms_; }
         int64_t GetInactiveTimeMs() const { return inactive_time_ms_; }
+
+        void SetTimes(int64_t join_time_ms, int64_t inactive_time_ms) {
+            join_time_ms_ = join_time_ms;
+            inactive_time_ms_ = inactive_time_ms;
+        }
     
     private:
         std::string name_;
@@ -320,6 +443,110 @@ class Dog {
         int64_t inactive_time_ms_;
     };
 
+
+// Стабильный идентификатор собаки внутри игровой сессии. В отличие от индекса
+// в DogStore не меняется при удалении других собак
+struct DogHandle {
+    uint32_t id;
+
+    auto operator<=>(const DogHandle&) const = default;
+};
+
+// Плотное хранилище собак сессии в виде структуры массивов: каждое поле собаки
+// лежит в своём непрерывном массиве, i-й элемент каждого массива относится к i-й собаке.
+// Удаление переносит последнюю собаку на место удалённой, поэтому индексы нестабильны
+class DogStore {
+public:
+    size_t Size() const noexcept { return ids_.size(); }
+    bool Empty() const noexcept { return ids_.empty(); }
+
+    std::optional<size_t> Find(DogHandle dog) const;
+    size_t Add(Dog dog);
+    void Remove(DogHandle dog);
+
+    // Копия собаки в виде отдельного объекта (для сериализации)
+    Dog Get(size_t index) const;
+
+    const std::vector<uint32_t>& GetIds() const noexcept { return ids_; }
+    const std::vector<std::string>& GetNames() const noexcept { return names_; }
+
+    // Номер тика, после которого собака последний раз менялась так, что это видно клиенту.
+    // Сеттеры DogRef отмечают изменение сами, прямую запись в столбцы отмечает вызывающий
+    const std::vector<uint64_t>& GetChangeTicks() const noexcept { return change_ticks_; }
+    void MarkChanged(size_t index) noexcept { change_ticks_[index] = change_tick_; }
+    void SetChangeTick(uint64_t tick) noexcept { change_tick_ = tick; }
+
+    std::vector<Position>& GetPositions() noexcept { return positions_; }
+    const std::vector<Position>& GetPositions() const noexcept { return positions_; }
+    std::vector<Velocity>& GetVelocities() noexcept { return velocities_; }
+    const std::vector<Velocity>& GetVelocities() const noexcept { return velocities_; }
+    std::vector<Direction>& GetDirections() noexcept { return directions_; }
+    const std::vector<Direction>& GetDirections() const noexcept { return directions_; }
+    std::vector<int>& GetPoints() noexcept { return points_; }
+    const std::vector<int>& GetPoints() const noexcept { return points_; }
+    std::vector<int64_t>& GetJoinTimes() noexcept { return join_times_ms_; }
+    const std::vector<int64_t>& GetJoinTimes() const noexcept { return join_times_ms_; }
+    std::vector<int64_t>& GetInactiveTimes() noexcept { return inactive_times_ms_; }
+    const std::vector<int64_t>& GetInactiveTimes() const noexcept { return inactive_times_ms_; }
+    std::vector<Bag>& GetBags() noexcept { return bags_; }
+    const std::vector<Bag>& GetBags() const noexcept { return bags_; }
+
+private:
+    std::vector<uint32_t> ids_;
+    std::vector<std::string> names_;
+    std::vector<Position> positions_;
+    std::vector<Velocity> velocities_;
+    std::vector<Direction> directions_;
+    std::vector<int> points_;
+    std::vector<int64_t> join_times_ms_;
+    std::vector<int64_t> inactive_times_ms_;
+    std::vector<Bag> bags_;
+    std::vector<uint64_t> change_ticks_;
+    uint64_t change_tick_ = 1;
+    std::unordered_map<uint32_t, size_t> index_by_id_;
+};
+
+// Доступ к одной собаке в DogStore с интерфейсом Dog.
+// Действителен до добавления или удаления собак
+class DogRef {
+public:
+    DogRef(DogStore& store, size_t index) : store_(&store), index_(index) {}
+
+    size_t GetIndex() const { return index_; }
+    uint32_t GetId() const { return store_->GetIds()[index_]; }
+    const std::string& GetName() const { return store_->GetNames()[index_]; }
+
+    Bag& GetBag() { return store_->GetBags()[index_]; }
+
+    Position GetPosition() const { return store_->GetPositions()[index_]; }
+    Velocity GetVelocity() const { return store_->GetVelocities()[index_]; }
+    Direction GetDirection() const { return store_->GetDirections()[index_]; }
+
+    void SetPosition(Position pos) { store_->GetPositions()[index_] = pos; store_->MarkChanged(index_); }
+    void SetVelocity(Velocity vel) { store_->GetVelocities()[index_] = vel; store_->MarkChanged(index_); }
+    void SetDirection(Direction dir) { store_->GetDirections()[index_] = dir; store_->MarkChanged(index_); }
+
+    void AddPoints(int points) { store_->GetPoints()[index_] += points; store_->MarkChanged(index_); }
+    int GetPoints() const { return store_->GetPoints()[index_]; }
+
+    void UpdateTimes(int64_t delta_ms) {
+        store_->GetJoinTimes()[index_] += delta_ms;
+        store_->GetInactiveTimes()[index_] = 0;
+    }
+
+    void AddInactiveTime(int64_t delta_ms) {
+        store_->GetJoinTimes()[index_] += delta_ms;
+        store_->GetInactiveTimes()[index_] += delta_ms;
+    }
+
+    int64_t GetJoinTimeMs() const { return store_->GetJoinTimes()[index_]; }
+    int64_t GetInactiveTimeMs() const { return store_->GetInactiveTimes()[index_]; }
+
+private:
+    DogStore* store_;
+    size_t index_;
+};
+
     class Loot {
     public:
         Loot(int type, Position pos, int id) : type_(type), pos_(pos), id_(id) {}
@@ -327,34 +554,79 @@ class Dog {
         int GetType() const { return type_; }
         Position GetPosition() const { return pos_; }
         int GetId() const { return id_; }
+
+        // Номер тика, после которого трофей появился. Ставит сессия
+        uint64_t GetAddedTick() const { return added_tick_; }
+        void SetAddedTick(uint64_t tick) { added_tick_ = tick; }
     private:
         int type_;
         Position pos_;
         int id_;
+        uint64_t added_tick_ = 0;
     };
     
     class GameSession {
     public:
-        explicit GameSession(std::shared_ptr<model::Map> map, bool randomize_spawn_points) : map_(std::move(map)), randomize_spawn_points_(randomize_spawn_points) {}
+        using Loots = util::SlotMap<Loot>;
+        using LootKey = Loots::Key;
+
+        // instance — номер экземпляра сессии среди сессий той же карты
+        // seed — начальное состояние генератора спавна
+        explicit GameSession(std::shared_ptr<model::Map> map, bool randomize_spawn_points, size_t instance = 0,
+                             uint64_t seed = util::RandomSeed())
+            : map_(std::move(map)), instance_(instance), randomize_spawn_points_(randomize_spawn_points)
+            , random_(seed) {}
     
-        std::shared_ptr<Dog> AddDog(const std::string& name, int bag_capacity);
+        DogHandle AddDog(const std::string& name, int bag_capacity);
         void AddLoots (int num);
     
-        const std::shared_ptr<Map> GetMap() const { return map_; }
-        const std::unordered_map<uint32_t, std::shared_ptr<Dog>>& GetDogs() const { return dogs_; }
-        const size_t GetNumLoots() const { return loots_.size(); }
-        const std::unordered_map<int, std::shared_ptr<Loot>>& GetLoots() const {return loots_; }
-
-        const std::shared_ptr<Dog> GetDog(uint32_t id) const;
-
-        void RemoveLoot(int id) { loots_.erase(id); }
-        void RemoveDog(uint32_t id) { dogs_.erase(id); }
+        const std::shared_ptr<Map>& GetMap() const { return map_; }
+        size_t GetInstance() const noexcept { return instance_; }
+        DogStore& GetDogs() { return dogs_; }
+        const DogStore& GetDogs() const { return dogs_; }
+        const size_t GetNumLoots() const { return loots_.Size(); }
+        const Loots& GetLoots() const { return loots_; }
+
+        std::optional<DogRef> GetDog(DogHandle dog);
+
+        bool RemoveLoot(LootKey key);
+        void RemoveDog(DogHandle dog);
+
+        // Версия видимого клиентам состояния. Растёт при каждом изменении сессии, в том числе
+        // через DogRef: такие изменения отмечает вызывающий. По версии кэшируются ответы API
+        uint64_t GetStateVersion() const noexcept { return state_version_; }
+        void MarkChanged() noexcept { ++state_version_; }
+
+        // Удалённая собака или трофей и номер тика, после которого удаление видно клиенту
+        struct Removal {
+            uint64_t tick;
+            int64_t id;
+        };
+
+        // Сколько последних тиков помнятся удаления. Клиенту, отставшему сильнее, нужна полная картина
+        static constexpr uint64_t DELTA_HISTORY_TICKS = 64;
+
+        // Число завершённых тиков сессии. Изменения помечаются номером следующего тика
+        uint64_t GetTick() const noexcept { return tick_; }
+        void FinishTick();
+
+        // Эпоха номеров тиков — случайное число, выбранное при запуске процесса. Номера тиков не сохраняются
+        // и после перезапуска идут заново, поэтому since имеет смысл только вместе с эпохой, в которой получен.
+        // Укладывается в 53 бита, чтобы клиент на JavaScript читал её без потерь
+        static uint64_t GetEpoch() noexcept;
+
+        // Можно ли собрать изменения после тика since эпохи epoch из истории. Иначе нужна полная картина
+        bool CanDeltaSince(uint64_t epoch, uint64_t since) const noexcept {
+            return epoch == GetEpoch() && since <= tick_ && since + DELTA_HISTORY_TICKS >= tick_;
+        }
+        const std::vector<Removal>& GetRemovedDogs() const noexcept { return removed_dogs_; }
+        const std::vector<Removal>& GetRemovedLoots() const noexcept { return removed_loots_; }
 
         uint32_t GetNextIdDog() const { return next_id_dog_; }
         int GetNextIdLoot() const { return next_id_loot_; }
 
-        void SetReadyDogs(std::unordered_map<uint32_t, std::shared_ptr<Dog>>&& dogs) { dogs_ = std::move(dogs);}
-        void SetReadyLoots(std::unordered_map<int, std::shared_ptr<Loot>>&& loots) { loots_ = std::move(loots); }
+        void RestoreDog(Dog dog) { MarkChanged(); dogs_.Add(std::move(dog)); }
+        void RestoreLoot(Loot loot) { MarkChanged(); loot.SetAddedTick(tick_ + 1); loots_.Insert(std::move(loot)); }
         void SetNextIdDog(uint32_t next_id_dog) { next_id_dog_ = next_id_dog; }
         void SetNextIdLoot(int next_id_loot) { next_id_loot_ = next_id_loot; }
 
@@ -364,11 +636,17 @@ class Dog {
         Position GetRandomPositionOnRoad();
         
         std::shared_ptr<model::Map>  map_;
-        std::unordered_map<uint32_t, std::shared_ptr<Dog>> dogs_;
-        std::unordered_map<int, std::shared_ptr<Loot>> loots_;
+        size_t instance_;
+        DogStore dogs_;
+        Loots loots_;
         uint32_t next_id_dog_ = 0;
         int next_id_loot_ = 0;
+        uint64_t state_version_ = 0;
+        uint64_t tick_ = 0;
+        std::vector<Removal> removed_dogs_;
+        std::vector<Removal> removed_loots_;
         bool randomize_spawn_points_;
+        util::Xoshiro256 random_;
     };
 
 class Game {
@@ -376,7 +654,9 @@ public:
     using Maps = std::vector<Map>;
     using MapIdHasher = util::TaggedHasher<Map::Id>;
     using MapIdToIndex = std::unordered_map<Map::Id, size_t, MapIdHasher>;
-    using GameSessions = std::unordered_map<Map::Id, std::shared_ptr<GameSession>, MapIdHasher>;
+    // Экземпляры сессий карты в порядке открытия: номер экземпляра совпадает с индексом
+    using SessionInstances = std::vector<std::shared_ptr<GameSession>>;
+    using GameSessions = std::unordered_map<Map::Id, SessionInstances, MapIdHasher>;
 
     explicit Game(bool randomize_spawn_points, std::shared_ptr<loot_gen::LootGenerator> loot_gener) : randomize_spawn_points_(randomize_spawn_points), loot_gener_(loot_gener) {}
 
@@ -390,24 +670,48 @@ public:
         default_bag_capacity_ = capacity;
     }
 
+    void SetMaxDogsPerSession(size_t max_dogs) {
+        max_dogs_per_session_ = max_dogs;
+    }
+
+    const std::optional<size_t>& GetMaxDogsPerSession() const noexcept {
+        return max_dogs_per_session_;
+    }
+
+    // С заданным seed генераторы сессий и токенов выводятся из него, и прогон воспроизводим.
+    // Без seed они берут энтропию ОС
+    void SetRandomSeed(uint64_t seed) {
+        random_seed_ = seed;
+    }
+
+    const std::optional<uint64_t>& GetRandomSeed() const noexcept {
+        return random_seed_;
+    }
+
+    // Seed генератора экземпляра сессии карты
+    uint64_t MakeSessionSeed(const Map::Id& id, size_t instance) const;
+
     const Maps& GetMaps() const noexcept {
         return maps_;
     }
 
     const Map* FindMap(const Map::Id& id) const noexcept;
 
+    // Наименее загруженный экземпляр сессии карты, в котором есть место.
+    // Если все экземпляры заполнены, открывается новый. Для неизвестной карты nullptr
     std::shared_ptr<GameSession> GetSession(const Map::Id& id);
+    std::shared_ptr<GameSession> FindSession(const Map::Id& id, size_t instance) const;
 
     double GetDefaultDogSpeed(const Map::Id& id) const noexcept;
     int GetDefaultBagCapacity(const Map::Id& id) const noexcept;
 
-    GameSessions GetSessions() { return sessions_; }
+    const GameSessions& GetSessions() const noexcept { return sessions_; }
 
-    std::shared_ptr<loot_gen::LootGenerator> GetLootGenerator() { return loot_gener_; }
+    const std::shared_ptr<loot_gen::LootGenerator>& GetLootGenerator() const noexcept { return loot_gener_; }
     
     bool GetSpawnPoints() const { return randomize_spawn_points_; }
 
-    void SetGameSessions(GameSessions sessions) { sessions_ = sessions; }
+    void SetGameSessions(GameSessions sessions) { sessions_ = std::move(sessions); }
 
 private:
     std::vector<Map> maps_;
@@ -417,6 +721,8 @@ private:
     bool randomize_spawn_points_;
     std::shared_ptr<loot_gen::LootGenerator> loot_gener_;
     int default_bag_capacity_ = 3;
+    std::optional<size_t> max_dogs_per_session_;
+    std::optional<uint64_t> random_seed_;
 };
 
 }  // namespace model   
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace util {
+
+// Состояние ParallelFor, которое вызывающий хранит между вызовами. Помощники, не успевшие запуститься
+// к концу вызова, остаются в очереди и подключаются к следующему вызову вместо новых, а память под
+// их задачи переиспользуется, поэтому в установившемся режиме вызов не обращается к куче.
+// Состояние должно пережить executor, и одно состояние не используется двумя вызовами одновременно
+class ParallelForState {
+public:
+    ParallelForState() = default;
+    ParallelForState(const ParallelForState&) = delete;
+    ParallelForState& operator=(const ParallelForState&) = delete;
+
+    // Выполняет fn(i) для i из [0, count) силами вызывающего потока и до helpers помощников на executor
+    template <typename Executor, typename Fn>
+    void Run(const Executor& executor, size_t helpers, size_t count, Fn& fn) {
+        assert(count <= INDEX_MASK);
+        Job job;
+        size_t new_helpers = 0;
+        {
+            std::lock_guard lock{mutex_};
+            job = Job{++generation_, count, &fn, [](void* fn, size_t i) {
+                (*static_cast<Fn*>(fn))(i);
+            }};
+            job_ = job;
+            done_ = 0;
+            error_ = nullptr;
+            // Номер вызова в курсоре не даёт помощнику со старым заданием взять индекс нового
+            cursor_.store(uint64_t{job.generation} << 32);
+            new_helpers = helpers > pending_ ? helpers - pending_ : 0;
+            pending_ += new_helpers;
+        }
+
+        for (size_t i = 0; i < new_helpers; ++i) {
+            boost::asio::post(executor, Helper{this});
+        }
+        Work(job);
+
+        std::unique_lock lock{mutex_};
+        cv_.wait(lock, [this, count] { return done_ == count; });
+        if (auto error = std::exchange(error_, nullptr)) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    static constexpr uint64_t INDEX_MASK = std::numeric_limits<uint32_t>::max();
+
+    struct Job {
+        uint32_t generation = 0;
+        size_t count = 0;
+        // fn живёт на стеке вызывающего, но тот не вернётся, пока не завершены все взятые индексы
+        void* fn = nullptr;
+        void (*invoke)(void* fn, size_t i) = nullptr;
+    };
+
+    // Блоки под задачи помощников. Освобождённый блок уходит в список и берётся снова.
+    // Помощники освобождают память на своих потоках, поэтому список под мьютексом
+    class TaskMemory {
+    public:
+        static constexpr size_t BLOCK_SIZE = 256;
+
+        TaskMemory() = default;
+        TaskMemory(const TaskMemory&) = delete;
+        TaskMemory& operator=(const TaskMemory&) = delete;
+
+        ~TaskMemory() {
+            while (free_) {
+                ::operator delete(std::exchange(free_, free_->next));
+            }
+        }
+
+        void* Allocate(size_t size) {
+            if (size > BLOCK_SIZE) {
+                return ::operator new(size);
+            }
+            {
+                std::lock_guard lock{mutex_};
+                if (free_) {
+                    return std::exchange(free_, free_->next);
+                }
+            }
+            return ::operator new(BLOCK_SIZE);
+        }
+
+        void Deallocate(void* p, size_t size) noexcept {
+            if (size > BLOCK_SIZE) {
+                ::operator delete(p);
+                return;
+            }
+            std::lock_guard lock{mutex_};
+            free_ = ::new (p) FreeBlock{free_};
+        }
+
+    private:
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        std::mutex mutex_;
+        FreeBlock* free_ = nullptr;
+    };
+
+    template <typename T>
+    struct TaskAllocator {
+        using value_type = T;
+
+        explicit TaskAllocator(TaskMemory* memory) noexcept : memory(memory) {}
+
+        template <typename U>
+        TaskAllocator(const TaskAllocator<U>& other) noexcept : memory(other.memory) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(memory->Allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, size_t n) noexcept {
+            memory->Deallocate(p, n * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const TaskAllocator<U>& other) const noexcept {
+            return memory == other.memory;
+        }
+
+        TaskMemory* memory;
+    };
+
+    // Задача помощника. Asio берёт память под неё через get_allocator
+    struct Helper {
+        using allocator_type = TaskAllocator<void>;
+
+        void operator()() const {
+            state->Help();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_type{&state->memory_};
+        }
+
+        ParallelForState* state;
+    };
+
+    // Помощник берёт задание, текущее на момент запуска
+    void Help() {
+        Job job;
+        {
+            std::lock_guard lock{mutex_};
+            --pending_;
+            job = job_;
+        }
+        Work(job);
+    }
+
+    // Следующий индекс вызова generation или count, если брать больше нечего
+    size_t Claim(uint32_t generation, size_t count) {
+        uint64_t cursor = cursor_.load();
+        while ((cursor >> 32) == generation && (cursor & INDEX_MASK) < count) {
+            if (cursor_.compare_exchange_weak(cursor, cursor + 1)) {
+                return static_cast<size_t>(cursor & INDEX_MASK);
+            }
+        }
+        return count;
+    }
+
+    void Work(const Job& job) {
+        size_t finished = 0;
+        std::exception_ptr error;
+        for (size_t i = Claim(job.generation, job.count); i < job.count; i = Claim(job.generation, job.count)) {
+            try {
+                job.invoke(job.fn, i);
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            ++finished;
+        }
+        if (finished == 0) {
+            return;
+        }
+
+        std::lock_guard lock{mutex_};
+        if (error && !error_) {
+            error_ = error;
+        }
+        done_ += finished;
+        if (done_ == job.count) {
+            cv_.notify_all();
+        }
+    }
+
+    // Старшие 32 бита — номер вызова, младшие — следующий индекс
+    std::atomic<uint64_t> cursor_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    uint32_t generation_ = 0;
+    Job job_;
+    // Помощники, отправленные на executor и ещё не запущенные
+    size_t pending_ = 0;
+    size_t done_ = 0;
+    std::exception_ptr error_;
+    TaskMemory memory_;
+};
+
+// Вызывает fn(i) для каждого i из [0, count) и возвращается, когда все вызовы завершены.
+// До concurrency - 1 помощников отправляются на executor, вызывающий поток работает вместе с ними.
+// Индексы разбираются из общего счётчика: вызывающий не ждёт запуска помощников,
+// поэтому вызов не зависает даже на io_context с единственным потоком.
+// Первое исключение из fn пробрасывается вызывающему после завершения остальных вызовов
+template <typename Executor, typename Fn>
+void ParallelFor(ParallelForState& state, const Executor& executor, unsigned concurrency, size_t count, Fn&& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    const size_t helpers = std::min<size_t>(std::max(concurrency, 1u) - 1, count - 1);
+    if (helpers == 0) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    state.Run(executor, helpers, count, fn);
+}
+
+}  // namespace util
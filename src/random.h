@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string_view>
+
+namespace util {
+
+// Шаг генератора splitmix64: хорошо перемешивает даже соседние значения state
+inline uint64_t SplitMix64(uint64_t& state) noexcept {
+    state += 0x9E3779B97F4A7C15ull;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Генератор xoshiro256**: 32 байта состояния, несколько тактов на число.
+// Детерминирован для заданного seed на любой платформе
+class Xoshiro256 {
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256(uint64_t seed) noexcept {
+        // Состояние разворачивается из seed через splitmix64, как рекомендуют авторы
+        for (auto& word : state_) {
+            word = SplitMix64(seed);
+        }
+    }
+
+    static constexpr result_type min() noexcept { return 0; }
+    static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() noexcept {
+        const uint64_t result = Rotl(state_[1] * 5, 7) * 9;
+        const uint64_t t = state_[1] << 17;
+
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= t;
+        state_[3] = Rotl(state_[3], 45);
+
+        return result;
+    }
+
+    // Равномерное число в [0, 1)
+    double NextDouble() noexcept {
+        return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+    }
+
+    // Равномерное число в [0, bound). bound должен быть положительным
+    uint64_t NextBelow(uint64_t bound) noexcept {
+        // Отбрасываем хвост диапазона, который не делится на bound, иначе остаток смещён
+        const uint64_t threshold = (0 - bound) % bound;
+        uint64_t value = (*this)();
+        while (value < threshold) {
+            value = (*this)();
+        }
+        return value % bound;
+    }
+
+private:
+    static constexpr uint64_t Rotl(uint64_t x, int k) noexcept {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t state_[4];
+};
+
+// Случайный seed из источника энтропии ОС
+inline uint64_t RandomSeed() {
+    std::random_device device;
+    return (static_cast<uint64_t>(device()) << 32) ^ device();
+}
+
+// Независимый seed для подсистемы key (и её экземпляра index), выведенный из общего seed.
+// Не зависит от платформы и std::hash, поэтому прогоны с одним seed совпадают
+inline uint64_t DeriveSeed(uint64_t seed, std::string_view key, uint64_t index = 0) noexcept {
+    uint64_t hash = 0xCBF29CE484222325ull;  // FNV-1a
+    for (char c : key) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    uint64_t state = seed ^ hash;
+    state = SplitMix64(state) ^ index;
+    return SplitMix64(state);
+}
+
+}  // namespace util
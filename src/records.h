@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct RetiredPlayer {
+    std::string name;
+    int score;
+    int64_t play_time_ms;
+};
+
+// Хранилище рекордов ушедших игроков. Основная реализация — DbHandler
+class RecordsRepository {
+public:
+    virtual ~RecordsRepository() = default;
+
+    virtual void SaveRetiredPlayer(const RetiredPlayer& player) = 0;
+    // Рекорды по убыванию очков, затем по возрастанию времени игры и имени
+    virtual std::vector<RetiredPlayer> GetRecords(int start, int max_items) = 0;
+};
+
+// Рекорды в памяти процесса: для бенчмарков и запуска без базы данных
+class InMemoryRecords : public RecordsRepository {
+public:
+    void SaveRetiredPlayer(const RetiredPlayer& player) override {
+        std::lock_guard lock{mutex_};
+        records_.push_back(player);
+    }
+
+    std::vector<RetiredPlayer> GetRecords(int start, int max_items) override {
+        std::lock_guard lock{mutex_};
+        std::vector<RetiredPlayer> sorted = records_;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const RetiredPlayer& lhs, const RetiredPlayer& rhs) {
+            if (lhs.score != rhs.score) {
+                return lhs.score > rhs.score;
+            }
+            if (lhs.play_time_ms != rhs.play_time_ms) {
+                return lhs.play_time_ms < rhs.play_time_ms;
+            }
+            return lhs.name < rhs.name;
+        });
+
+        const auto first = std::min(static_cast<size_t>(std::max(start, 0)), sorted.size());
+        const auto last = std::min(first + static_cast<size_t>(std::max(max_items, 0)), sorted.size());
+        return {sorted.begin() + first, sorted.begin() + last};
+    }
+
+    size_t Size() const {
+        std::lock_guard lock{mutex_};
+        return records_.size();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<RetiredPlayer> records_;
+};
@@ -1,7 +1,10 @@
 #include "request_handler.h"
 #include "json_utils.h"
+#include "state_binary.h"
+#include "http_cache.h"
 
 #include <boost/beast.hpp>
+#include <charconv>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -14,30 +17,6 @@ namespace http = beast::http;
 namespace sys = boost::system;
 
 namespace http_handler {
-    std::unordered_map<std::string, std::string_view> content_types = {
-        {"html", ContentType::TEXT_HTML}, {"htm", ContentType::TEXT_HTML},
-        {"css", ContentType::TEXT_CSS},
-        {"txt", ContentType::TEXT_PLAIN},
-        {"js", ContentType::TEXT_JS},
-        {"json", ContentType::APPLICATION_JSON},
-        {"xml", ContentType::APPLICATION_XML},
-        {"png", ContentType::IMAGE_PNG},
-        {"jpg", ContentType::IMAGE_JPEG}, {"jpeg", ContentType::IMAGE_JPEG}, {"jpe", ContentType::IMAGE_JPEG},
-        {"gif", ContentType::IMAGE_GIF},
-        {"bmp", ContentType::IMAGE_BMP},
-        {"ico", ContentType::IMAGE_VND_MICROSOFT_ICON},
-        {"tiff", ContentType::IMAGE_TIFF}, {"tif", ContentType::IMAGE_TIFF},
-        {"svg", ContentType::IMAGE_SVG_XML}, {"svgz", ContentType::IMAGE_SVG_XML},
-        {"mp3", ContentType::AUDIO_MPEG}
-    };
-    
-    std::string_view GetContentType(const std::string& extension) {
-        if (auto it = content_types.find(extension); it != content_types.end()) {
-            return it->second;
-        }
-        return ContentType::APPLICATION_OCTET_STREAM;
-    }
-
     StringResponse MakeStringResponseGet(http::status status, std::string_view body, unsigned http_version,
         bool keep_alive, std::string_view content_type) {
         StringResponse response(status, http_version);
@@ -57,37 +36,187 @@ namespace http_handler {
         return MakeStringResponseGet(status, serialize(error_object), version, keep_alive);
     }
 
+    constexpr std::string_view BEARER_PREFIX = "Bearer ";
+
+    template <typename Request>
+    bool HasBearerAuthorization(const Request& req) {
+        std::string_view auth_header = req[http::field::authorization];
+        return auth_header.starts_with(BEARER_PREFIX);
+    }
+
+    // Разбирает токен прямо из заголовка, без копирования строки
     template <typename Request>
-    bool ValidateToken(const Request& req, std::string& token, StringResponse& error_response) {
-        auto auth_header = req[http::field::authorization];
-        if (auth_header.empty() || auth_header.substr(0, 7) != "Bearer ") {
+    std::optional<players::Token> ParseBearerToken(const Request& req) {
+        std::string_view auth_header = req[http::field::authorization];
+        if (!auth_header.starts_with(BEARER_PREFIX)) {
+            return std::nullopt;
+        }
+        return players::Token::Parse(auth_header.substr(BEARER_PREFIX.size()));
+    }
+
+    template <typename Request>
+    bool ValidateToken(const Request& req, players::Token& token, StringResponse& error_response) {
+        if (!HasBearerAuthorization(req)) {
             error_response = MakeErrorResponse(http::status::unauthorized, "invalidToken", "Authorization header is missing",
                                                req.version(), req.keep_alive());
             return false;
         }
 
-        token = std::string(auth_header).substr(7);
-        if (token.length() != 32) {
+        auto parsed = ParseBearerToken(req);
+        if (!parsed) {
             error_response = MakeErrorResponse(http::status::unauthorized, "invalidToken", "Invalid token",
                                                req.version(), req.keep_alive());
             return false;
         }
 
+        token = *parsed;
         return true;
     }
 
-    StringResponse ApiHandler::HandleStringRequest(const StringRequest& req) {
+    // Путь запроса без строки параметров
+    std::string_view GetTargetPath(std::string_view target) {
+        return target.substr(0, target.find('?'));
+    }
+
+    // Значение параметра name из строки запроса или nullopt, если его нет
+    std::optional<std::string_view> FindQueryParam(std::string_view target, std::string_view name) {
+        const auto question = target.find('?');
+        if (question == std::string_view::npos) {
+            return std::nullopt;
+        }
+        std::string_view query = target.substr(question + 1);
+        while (!query.empty()) {
+            const auto amp = query.find('&');
+            const std::string_view param = query.substr(0, amp);
+            const auto eq = param.find('=');
+            if (param.substr(0, eq) == name) {
+                return eq == std::string_view::npos ? std::string_view{} : param.substr(eq + 1);
+            }
+            query = amp == std::string_view::npos ? std::string_view{} : query.substr(amp + 1);
+        }
+        return std::nullopt;
+    }
+
+    std::string RedactTarget(std::string_view target) {
+        const auto question = target.find('?');
+        if (question == std::string_view::npos) {
+            return std::string{target};
+        }
+        std::string redacted{target.substr(0, question + 1)};
+        std::string_view query = target.substr(question + 1);
+        while (true) {
+            const auto amp = query.find('&');
+            const std::string_view param = query.substr(0, amp);
+            const auto eq = param.find('=');
+            if (eq != std::string_view::npos && param.substr(0, eq) == "token") {
+                redacted.append(param.substr(0, eq + 1)).append("REDACTED");
+            } else {
+                redacted.append(param);
+            }
+            if (amp == std::string_view::npos) {
+                return redacted;
+            }
+            redacted += '&';
+            query = query.substr(amp + 1);
+        }
+    }
+
+    // Десятичное число без знака, занимающее всю строку
+    bool ParseUnsigned(std::string_view text, uint64_t& value) {
+        const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc{} && end == text.data() + text.size();
+    }
+
+    // Двоичный формат отдаётся, только если клиент явно перечислил его в Accept
+    bool AcceptsGameBinary(const StringRequest& req) {
+        std::string_view accept = req[http::field::accept];
+        while (!accept.empty()) {
+            const auto comma = accept.find(',');
+            std::string_view media_range = accept.substr(0, comma);
+            media_range = media_range.substr(0, media_range.find(';'));
+            const auto first = media_range.find_first_not_of(' ');
+            const auto last = media_range.find_last_not_of(' ');
+            if (first != std::string_view::npos && media_range.substr(first, last - first + 1) == ContentType::APPLICATION_GAME_BINARY) {
+                return true;
+            }
+            accept = comma == std::string_view::npos ? std::string_view{} : accept.substr(comma + 1);
+        }
+        return false;
+    }
+
+    // Снимок тика уходит всем запросам этого тика одним буфером, без копирования.
+    // Ответ /game/state и /game/players зависит от Accept, это видно кэшам через Vary
+    SharedBufferResponse MakeNegotiatedResponse(const StringRequest& req, StateSnapshots::Buffer body,
+                                                std::string_view content_type) {
+        SharedBufferResponse response(http::status::ok, req.version());
+        response.set(http::field::content_type, content_type);
+        response.set(http::field::cache_control, "no-cache");
+        response.set(http::field::vary, "Accept");
+        response.keep_alive(req.keep_alive());
+        response.content_length(body->size());
+        response.body() = std::move(body);
+        return response;
+    }
+
+    // Готовое тело с его ETag или пустой 304, если у клиента та же версия
+    SharedBufferResponse MakeCachedResponse(const StringRequest& req, const CachedBody& cached,
+                                            std::string_view content_type = ContentType::APPLICATION_JSON) {
+        const bool not_modified = MatchesIfNoneMatch(req[http::field::if_none_match], cached.etag);
+        SharedBufferResponse response(not_modified ? http::status::not_modified : http::status::ok, req.version());
+        response.set(http::field::content_type, content_type);
+        response.set(http::field::etag, cached.etag);
+        response.set(http::field::cache_control, "no-cache");
+        response.keep_alive(req.keep_alive());
+        if (!not_modified) {
+            response.body() = cached.body;
+            response.content_length(cached.body->size());
+        }
+        return response;
+    }
+
+    bool IsPlayerTarget(std::string_view target) {
+        const auto path = GetTargetPath(target);
+        return path == "/api/v1/game/player/action" || path == "/api/v1/game/players" || path == "/api/v1/game/state";
+    }
+
+    ApiHandler::SessionsAccess ApiHandler::GetSessionsAccess(std::string_view target) const {
+        if (target == "/api/v1/game/join" || (target == "/api/v1/game/tick" && !auto_ticket_)) {
+            return SessionsAccess::EXCLUSIVE;
+        }
+        return IsPlayerTarget(target) ? SessionsAccess::SHARED : SessionsAccess::NONE;
+    }
+
+    std::optional<players::Token> ApiHandler::GetRequestToken(const StringRequest& req) {
+        return ParseBearerToken(req);
+    }
+
+    Strand ApiHandler::GetPlayerStrand(const std::optional<players::Token>& token) {
+        // Неизвестный токен обработается на api_strand и получит обычный ответ об ошибке
+        auto session = token ? app_.FindPlayerSession(*token) : nullptr;
+        return session ? GetSessionStrand(session.get()) : api_strand_;
+    }
+
+    Strand ApiHandler::GetSessionStrand(const model::GameSession* session) {
+        std::lock_guard lock{session_strands_mutex_};
+        auto it = session_strands_.find(session);
+        if (it == session_strands_.end()) {
+            it = session_strands_.emplace(session, boost::asio::make_strand(api_strand_.get_inner_executor())).first;
+        }
+        return it->second;
+    }
+
+    ApiHandler::ApiResponse ApiHandler::HandleApiRequest(const StringRequest& req, const app::SessionsGate::Pass& pass) {
         std::string_view target = req.target();
         
         if (target == "/api/v1/game/join") {
             return HandleJoinGame(req);
         } else if (target == "/api/v1/game/tick" && !auto_ticket_) {
-            return HandleMoveDogs(req);
+            return HandleMoveDogs(req, pass);
         } else if (target == "/api/v1/game/player/action") {
             return HandleActionGame(req);
         } else if (target == "/api/v1/game/players") {
             return HandleGetPlayers(req);
-        } else if (target == "/api/v1/game/state" ) {
+        } else if (GetTargetPath(target) == "/api/v1/game/state" ) {
             return HandleGetGameState(req);
         } else if (target == "/api/v1/maps" || target == "/api/v1/maps/") {
             return HandleGetMaps(req);
@@ -100,6 +229,44 @@ namespace http_handler {
         }
     }
 
+    void ApiHandler::HandleUpgrade(beast::tcp_stream&& stream, StringRequest&& req) {
+        if (GetTargetPath(req.target()) != "/api/v1/game/state/ws") {
+            return http_server::RejectUpgrade(std::move(stream), HandleBadRequest(req));
+        }
+
+        // Браузерный WebSocket не умеет ставить заголовки, поэтому токен принимается и параметром token
+        auto token = ParseBearerToken(req);
+        if (!token) {
+            if (auto token_param = FindQueryParam(req.target(), "token")) {
+                token = players::Token::Parse(*token_param);
+            }
+        }
+        if (!token) {
+            return http_server::RejectUpgrade(std::move(stream),
+                MakeErrorResponse(http::status::unauthorized, "invalidToken", "Invalid token", req.version(), false));
+        }
+
+        auto executor = stream.get_executor();
+        app_.GetSessionsGate().AsyncShared(executor,
+            [this, stream = std::move(stream), req = std::move(req), token = *token](app::SessionsGate::Pass pass) mutable {
+                auto session = app_.FindPlayerSession(token);
+                if (!session) {
+                    return http_server::RejectUpgrade(std::move(stream),
+                        MakeErrorResponse(http::status::unauthorized, "unknownToken", "Player token has not been found",
+                                          req.version(), false));
+                }
+                // Первый кадр читает состояние сессии, которое действия игроков меняют на её strand
+                auto strand = GetSessionStrand(session.get());
+                boost::asio::dispatch(strand, [this, stream = std::move(stream), req = std::move(req), token,
+                                               session = std::move(session), pass = std::move(pass)]() mutable {
+                    auto connection = std::make_shared<http_server::WebSocketSession>(std::move(stream));
+                    publisher_->Subscribe(std::move(session), token, connection);
+                    pass.Release();
+                    connection->Run(std::move(req));
+                });
+            });
+    }
+
     StringResponse ApiHandler::HandleJoinGame(const StringRequest& req) const {
         const auto text_response = [&req](http::status status, std::string_view text) {
             return MakeStringResponseGet(status, text, req.version(), req.keep_alive());
@@ -137,7 +304,7 @@ namespace http_handler {
             }
 
             object response;
-            response["authToken"] = result->token;
+            response["authToken"] = result->token.ToString();
             response["playerId"] = result->player_id;
             
             auto res = text_response(http::status::ok, serialize(response));
@@ -148,7 +315,7 @@ namespace http_handler {
         }
     }
 
-    StringResponse ApiHandler::HandleMoveDogs(const StringRequest& req) {
+    StringResponse ApiHandler::HandleMoveDogs(const StringRequest& req, const app::SessionsGate::Pass& pass) {
         const auto text_response = [&req](http::status status, std::string_view text) {
             return MakeStringResponseGet(status, text, req.version(), req.keep_alive());
         };
@@ -170,7 +337,7 @@ namespace http_handler {
             
             std::chrono::milliseconds timeDelta = static_cast<std::chrono::milliseconds>(json_body.as_object().at("timeDelta").as_int64());
 
-            app_.Tick(timeDelta);
+            app_.Tick(timeDelta, pass);
 
             return text_response(http::status::ok, "{}");
         } catch (const std::exception& e) {
@@ -197,7 +364,7 @@ namespace http_handler {
             return res;
         }
 
-        std::string token;
+        players::Token token;
         StringResponse error_response;
         if (!ValidateToken(req, token, error_response)) {
             return error_response;
@@ -234,11 +401,7 @@ namespace http_handler {
         }
     }
 
-    StringResponse ApiHandler::HandleGetPlayers(const StringRequest& req) const {
-        const auto text_response = [&req](http::status status, std::string_view text) {
-            return MakeStringResponseGet(status, text, req.version(), req.keep_alive());
-        };
-
+    ApiHandler::ApiResponse ApiHandler::HandleGetPlayers(const StringRequest& req) {
         if (req.method() != http::verb::get && req.method() != http::verb::head) {
             auto res = MakeErrorResponse(http::status::method_not_allowed, "invalidMethod", "Only POST method is expected",
                 req.version(), req.keep_alive());
@@ -246,35 +409,27 @@ namespace http_handler {
             return res;
         }
     
-        std::string token;
+        players::Token token;
         StringResponse error_response;
         if (!ValidateToken(req, token, error_response)) {
             return error_response;
         }
         
         auto players = app_.GetPlayersScenario()->Execute(token);
-        if (players.empty()) {
+        if (!players) {
             return MakeErrorResponse(http::status::unauthorized, "unknownToken", "Player token has not been found",
                 req.version(), req.keep_alive());
         }
     
-        object response;
-        for (const auto& player : players) {
-            object player_object;
-            player_object["name"] = player.name;
-            response[std::to_string(player.id)] = std::move(player_object);
+        if (AcceptsGameBinary(req)) {
+            auto body = snapshots_->GetPlayersBinary(players->session);
+            return MakeNegotiatedResponse(req, std::move(body), ContentType::APPLICATION_GAME_BINARY);
         }
-        
-        auto res = text_response(http::status::ok, serialize(response));
-            return res;
+        auto body = snapshots_->GetPlayers(players->session);
+        return MakeNegotiatedResponse(req, std::move(body), ContentType::APPLICATION_JSON);
     }
 
-    double FormatDouble(double value) {
-        double roundedNumber = std::round(value * 100.0) / 100.0;
-        return roundedNumber;
-    }
-
-    StringResponse ApiHandler::HandleGetGameState (const StringRequest& req) const {
+    ApiHandler::ApiResponse ApiHandler::HandleGetGameState (const StringRequest& req) {
         const auto text_response = [&req](http::status status, std::string_view text) {
             return MakeStringResponseGet(status, text, req.version(), req.keep_alive());
         };
@@ -286,55 +441,41 @@ namespace http_handler {
             return res;
         }
 
-        std::string token;
+        players::Token token;
         StringResponse error_response;
         if (!ValidateToken(req, token, error_response)) {
             return error_response;
         }
 
-        auto [players, loots] = app_.GetGameStateScenario()->Execute(token);
+        auto state = app_.GetGameStateScenario()->Execute(token);
 
-        if (players.empty()) {
+        if (!state) {
             return MakeErrorResponse(http::status::unauthorized, "unknownToken", "Player token has not been found",
                 req.version(), req.keep_alive());
         }
 
-        object players_json;
-        for (const auto& player : players) {
-            object player_obj;
-            player_obj["pos"] = {FormatDouble(player.position.x), FormatDouble(player.position.y)};
-            player_obj["speed"] = {FormatDouble(player.velocity.dx),FormatDouble(player.velocity.dy)};
-            player_obj["dir"] = model::DirectionToString(player.direction);
-
-            array bag_player;
-            for (auto& [id, type] : player.bag) {
-                object loot_obj;
-                loot_obj["id"] = id;
-                loot_obj["type"] = type;
-                bag_player.push_back(loot_obj);
+        // ?since=<tick>&epoch=<epoch> — только изменения после этого тика. Номер тика из другой эпохи,
+        // например полученный до перезапуска сервера, даёт полное состояние
+        if (auto since_param = FindQueryParam(req.target(), "since")) {
+            auto epoch_param = FindQueryParam(req.target(), "epoch");
+            uint64_t since = 0;
+            uint64_t epoch = 0;
+            if (!epoch_param || !ParseUnsigned(*since_param, since) || !ParseUnsigned(*epoch_param, epoch)) {
+                return MakeErrorResponse(http::status::bad_request, "invalidArgument",
+                    "since and epoch must be given together as unsigned integers", req.version(), req.keep_alive());
             }
-            player_obj["bag"] = bag_player;
-
-            player_obj["score"] = player.points;
-
-            players_json[std::to_string(player.id)] = player_obj;
+            return text_response(http::status::ok, BuildStateDeltaJson(state->session, epoch, since));
         }
 
-        object loots_json;
-        for (const auto& loot : loots) {
-            boost::json::object loot_obj;
-            loot_obj["type"] = loot.type;
-            loot_obj["pos"] = {FormatDouble(loot.position.x), FormatDouble(loot.position.y)};
-            loots_json[std::to_string(loot.id)] = loot_obj;
+        if (AcceptsGameBinary(req)) {
+            auto body = snapshots_->GetStateBinary(state->session);
+            return MakeNegotiatedResponse(req, std::move(body), ContentType::APPLICATION_GAME_BINARY);
         }
-
-        object response = {{"players", players_json}, {"lostObjects", loots_json}};
-
-        auto res = text_response(http::status::ok, serialize(response));
-            return res;
+        auto body = snapshots_->GetState(state->session);
+        return MakeNegotiatedResponse(req, std::move(body), ContentType::APPLICATION_JSON);
     }
     
-    StringResponse ApiHandler::HandleGetMaps(const StringRequest& req) const {
+    ApiHandler::ApiResponse ApiHandler::HandleGetMaps(const StringRequest& req) const {
         if (req.method() != http::verb::get && req.method() != http::verb::head) {
             auto res = MakeErrorResponse(http::status::method_not_allowed, "invalidMethod", "Only GET, HEAD method is expected",
                 req.version(), req.keep_alive());
@@ -342,19 +483,10 @@ namespace http_handler {
             return res;
         }
 
-        auto maps = app_.GetMapsScenario()->Execute();
-
-        array maps_json;
-        for (const auto& map : maps) {
-            boost::json::object obj;
-            obj["id"] = map.id;
-            obj["name"] = map.name;
-            maps_json.push_back(obj);
-        }
-        return MakeStringResponseGet(http::status::ok, serialize(maps_json), req.version(), req.keep_alive());
+        return MakeCachedResponse(req, map_responses_.GetList());
     }
 
-    StringResponse ApiHandler::HandleGetMapById(const StringRequest& req) const {
+    ApiHandler::ApiResponse ApiHandler::HandleGetMapById(const StringRequest& req) const {
         if (req.method() != http::verb::get && req.method() != http::verb::head) {
             auto res = MakeErrorResponse(http::status::method_not_allowed, "invalidMethod", "Only GET, HEAD method is expected",
                 req.version(), req.keep_alive());
@@ -362,18 +494,13 @@ namespace http_handler {
             return res;
         }
         
-        std::string map_id = std::string(req.target()).substr(13);
-        auto map = app_.GetMapByIdScenario()->Execute(map_id);
-    
+        const auto* map = map_responses_.FindMap(req.target().substr(13));
         if (!map) {
             return MakeErrorResponse(http::status::not_found, "mapNotFound", "Map not found",
                 req.version(), req.keep_alive());
         }
 
-        auto map_json = json_utils::MapToJson(*map);
-        map_json["lootTypes"] = ex_data_.GetLootsForMap(map_id);
-        
-        return MakeStringResponseGet(http::status::ok, serialize(map_json), req.version(), req.keep_alive());
+        return MakeCachedResponse(req, *map);
     }
 
     StringResponse ApiHandler::HandleGetRecords(const StringRequest& req) const {
@@ -450,14 +577,10 @@ namespace http_handler {
             req.version(), req.keep_alive());
     }
 
-    StringResponse RequestHandler::HandleStringRequest(const StringRequest& req) {
-        return api_handler_.HandleStringRequest(req);
-    }
-
-    std::string ToLower(const std::string& str) {
-        std::string lower_str = str;
-        std::transform(lower_str.begin(), lower_str.end(), lower_str.begin(), ::tolower);
-        return lower_str;
+    void RequestHandler::HandleUpgrade(beast::tcp_stream&& stream, StringRequest&& req) {
+        sys::error_code ec;
+        LoggingRequest(req, stream.socket().remote_endpoint(ec));
+        api_handler_.HandleUpgrade(std::move(stream), std::move(req));
     }
 
     std::string UrlDecode(const std::string& encoded) {
@@ -484,47 +607,106 @@ namespace http_handler {
         return decoded.str();
     }
 
-    bool IsSubPath(fs::path path, fs::path base) {
-        path = fs::weakly_canonical(path);
-        base = fs::weakly_canonical(base);
-    
-        for (auto b = base.begin(), p = path.begin(); b != base.end(); ++b, ++p) {
-            if (p == path.end() || *p != *b) {
-                return false;
+    bool EscapesRoot(std::string_view path) {
+        int depth = 0;
+        while (!path.empty()) {
+            const auto slash = path.find('/');
+            const auto segment = path.substr(0, slash);
+            if (segment == "..") {
+                if (--depth < 0) {
+                    return true;
+                }
+            } else if (!segment.empty() && segment != ".") {
+                ++depth;
             }
+            path = slash == std::string_view::npos ? std::string_view{} : path.substr(slash + 1);
         }
-        return true;
+        return false;
     }
 
-    std::string GetFileExtension(const std::string_view filename) {
-        size_t dot_pos = filename.rfind('.');
-        
-        if (dot_pos != std::string::npos && dot_pos != 0) {
-            return ToLower(std::string(filename).substr(dot_pos + 1));
+    // Большой файл с диска целиком или диапазоном из заголовка Range
+    StaticFileResponse MakeFileRangeResponse(const StringRequest& req, const StaticFiles::File& file,
+                                                             const auto& set_headers) {
+        // If-Range с устаревшей версией — клиенту нужен весь файл заново
+        const std::string_view if_range = req[http::field::if_range];
+        const bool range_allowed = if_range.empty() || if_range == file.etag || if_range == file.last_modified;
+        const auto range = range_allowed ? ParseRange(req[http::field::range], file.size) : RangeRequest{};
+
+        if (range.kind == RangeRequest::Kind::UNSATISFIABLE) {
+            auto response = MakeStringResponseGet(http::status::range_not_satisfiable, "", req.version(), req.keep_alive(),
+                                                  file.content_type);
+            response.set(http::field::content_range, "bytes */" + std::to_string(file.size));
+            return response;
         }
-        return "";
 
-    }
+        http_server::FileRangeBody::value_type body;
+        sys::error_code ec;
+        body.file.open(file.path.string().c_str(), beast::file_mode::read, ec);
+        if (ec) {
+            auto res = MakeErrorResponse(http::status::not_found, "fileNotFound", "The requested file was not found",
+                                         req.version(), req.keep_alive());
+            res.set(http::field::content_type, ContentType::TEXT_PLAIN);
+            return res;
+        }
 
-    FileResponse MakeFileResponse(http::status status, http::file_body::value_type&& file,
-        unsigned http_version, std::string_view content_type) {
-        FileResponse response(status, http_version);
-        response.set(http::field::content_type, content_type);
-        response.body() = std::move(file);
-        response.prepare_payload();
-        return response;
+        const bool partial = range.kind == RangeRequest::Kind::PARTIAL;
+        body.offset = partial ? range.offset : 0;
+        body.size = partial ? range.length : file.size;
+
+        FileRangeResponse response(partial ? http::status::partial_content : http::status::ok, req.version());
+        set_headers(response);
+        response.set(http::field::accept_ranges, "bytes");
+        if (partial) {
+            response.set(http::field::content_range, "bytes " + std::to_string(body.offset) + "-"
+                + std::to_string(body.offset + body.size - 1) + "/" + std::to_string(file.size));
         }
+        response.content_length(body.size);
+        response.body() = std::move(body);
+        return response;
+    }
 
-    RequestHandler::StaticFileResponse RequestHandler::HandleStaticFileRequest(StringRequest&& req) {
-        //Поддержка файлов
-        using namespace http;
-        std::string request_path = static_file_ + UrlDecode(std::string(req.target()));
+    // Файл из индекса: сжатый, если клиент принимает gzip, или пустой 304, если его версия не изменилась
+    StaticFileResponse MakeStaticFileResponse(const StringRequest& req, const StaticFiles::File& file) {
+        const bool gzip = file.gzip_body && AcceptsEncoding(req[http::field::accept_encoding], "gzip");
+        const std::string& etag = gzip ? file.gzip_etag : file.etag;
+
+        const std::string_view if_none_match = req[http::field::if_none_match];
+        const bool not_modified = !if_none_match.empty()
+            ? MatchesIfNoneMatch(if_none_match, etag)
+            : req[http::field::if_modified_since] == file.last_modified;
+
+        const auto set_headers = [&](auto& response) {
+            response.set(http::field::content_type, file.content_type);
+            response.set(http::field::etag, etag);
+            response.set(http::field::last_modified, file.last_modified);
+            response.set(http::field::cache_control, "no-cache");
+            if (file.gzip_body) {
+                response.set(http::field::vary, "Accept-Encoding");
+            }
+            response.keep_alive(req.keep_alive());
+        };
 
-        if (fs::is_directory(request_path)) {
-            request_path += "/index.html";
+        if (!file.body && !not_modified) {
+            return MakeFileRangeResponse(req, file, set_headers);
         }
 
-        if (!IsSubPath(request_path, static_file_)) {
+        SharedBufferResponse response(not_modified ? http::status::not_modified : http::status::ok, req.version());
+        set_headers(response);
+        if (!not_modified) {
+            if (gzip) {
+                response.set(http::field::content_encoding, "gzip");
+            }
+            response.body() = gzip ? file.gzip_body : file.body;
+            response.content_length(response.body()->size());
+        }
+        return response;
+    }
+
+    StaticFileResponse HandleStaticFileRequest(const StaticFiles& files, const StringRequest& req) {
+        // Файлы берутся только из индекса www-root, собранного при старте
+        std::string path = UrlDecode(std::string(GetTargetPath(req.target())));
+
+        if (EscapesRoot(path)) {
             auto res = MakeErrorResponse(http::status::bad_request, 
                 "invalidPath", 
                 "Access to the requested file is not allowed",
@@ -533,15 +715,12 @@ namespace http_handler {
             res.set(http::field::content_type, ContentType::TEXT_PLAIN);
             return res;
         }
+        if (path.find("/.") != std::string::npos || path.find("//") != std::string::npos) {
+            path = fs::path(path).lexically_normal().generic_string();
+        }
 
-        std::string extension = GetFileExtension(request_path);
-        std::string content_type = std::string(GetContentType(extension));
-
-        file_body::value_type file;
-        sys::error_code ec;
-        file.open(request_path.c_str(), beast::file_mode::read, ec);
-
-        if (ec) {
+        const auto* file = files.Find(path);
+        if (!file) {
             auto res = MakeErrorResponse(http::status::not_found,
                                    "fileNotFound",
                                    "The requested file was not found",
@@ -550,9 +729,8 @@ namespace http_handler {
             res.set(http::field::content_type, ContentType::TEXT_PLAIN);
             return res;
         }
-    
 
-        return MakeFileResponse(http::status::ok, std::move(file), 11, content_type);
+        return MakeStaticFileResponse(req, *file);
     }
 }  // namespace http_handler
 
@@ -11,11 +11,17 @@
 #include <boost/beast.hpp>
 #include <variant>
 #include <optional>
+#include <mutex>
+#include <unordered_map>
 
 #include "http_server.h"
 #include "application.h"
 #include "json_logger.h"
 #include "extra_data.h"
+#include "state_snapshots.h"
+#include "state_publisher.h"
+#include "map_responses.h"
+#include "static_files.h"
 
 namespace fs = std::filesystem;
 using namespace std::literals;
@@ -26,6 +32,8 @@ using namespace boost::json;
 using StringRequest = http::request<http::string_body>;
 using StringResponse = http::response<http::string_body>;
 using FileResponse = http::response<http::file_body>;
+using SharedBufferResponse = http::response<http_server::SharedBufferBody>;
+using FileRangeResponse = http::response<http_server::FileRangeBody>;
 
 using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
 
@@ -48,49 +56,131 @@ struct ContentType {
     constexpr static std::string_view IMAGE_SVG_XML = "image/svg+xml"sv;
     constexpr static std::string_view AUDIO_MPEG = "image/mpeg"sv;
     constexpr static std::string_view APPLICATION_OCTET_STREAM = "application/octet-stream"sv;
+    // Двоичное состояние игры, см. state_binary.h
+    constexpr static std::string_view APPLICATION_GAME_BINARY = "application/x-game-binary"sv;
 };
 
 StringResponse MakeStringResponseGet(http::status status, std::string_view body, unsigned http_version,
     bool keep_alive,
     std::string_view content_type = ContentType::APPLICATION_JSON);
 
+// Цель запроса для журнала: значение параметра token скрыто, чтобы токены игроков не попадали в логи
+std::string RedactTarget(std::string_view target);
+
+using StaticFileResponse = std::variant<StringResponse, FileRangeResponse, SharedBufferResponse>;
+
+std::string UrlDecode(const std::string& encoded);
+
+// Путь поднимается выше корня через ".."
+bool EscapesRoot(std::string_view path);
+
+// Отдаёт файл из индекса files по пути запроса без строки параметров. Диск трогается только ради больших файлов
+StaticFileResponse HandleStaticFileRequest(const StaticFiles& files, const StringRequest& req);
+
 class ApiHandler {
 public:
+    // Готовые неизменяемые тела уходят без копирования
+    using ApiResponse = std::variant<StringResponse, SharedBufferResponse>;
+
     explicit ApiHandler(app::Application& app, Strand api_strand, std::optional<int> auto_ticket, ExtraData& ex_data) 
-    : app_{app}, api_strand_{api_strand}, move_dogs_timer_(api_strand_), auto_ticket_(auto_ticket), ex_data_{ex_data} {}
+    : app_{app}, api_strand_{api_strand}, snapshots_{std::make_shared<StateSnapshots>()}
+    , publisher_{std::make_shared<StatePublisher>(app, snapshots_)}, map_responses_{app, ex_data}
+    , move_dogs_timer_(api_strand_), auto_ticket_(auto_ticket), ex_data_{ex_data} {}
+
+    // Выполняет запрос и вызывает handler(ApiResponse) на strand запроса: запросы игрока — на strand
+    // его сессии, остальные — на общем api_strand. Доступа к сессиям запрос ждёт, не занимая поток
+    template <typename Handler>
+    void AsyncHandleApiRequest(StringRequest&& req, Handler&& handler);
+
+    // Подписывает соединение на состояние сессии игрока через WebSocket
+    void HandleUpgrade(beast::tcp_stream&& stream, StringRequest&& req);
+
+    // Рассылке нужен каждый тик, её регистрируют слушателем приложения
+    std::shared_ptr<StatePublisher> GetStatePublisher() const { return publisher_; }
 
-    StringResponse HandleStringRequest(const StringRequest& req);
 private:
+    enum class SessionsAccess {
+        NONE,
+        SHARED,
+        EXCLUSIVE
+    };
+
+    SessionsAccess GetSessionsAccess(std::string_view target) const;
+    ApiResponse HandleApiRequest(const StringRequest& req, const app::SessionsGate::Pass& pass);
     StringResponse HandleJoinGame(const StringRequest& req) const;
     StringResponse HandleActionGame(const StringRequest& req) const;
-    StringResponse HandleGetPlayers(const StringRequest& req) const;
-    StringResponse HandleGetGameState(const StringRequest& req) const;
-    StringResponse HandleGetMaps(const StringRequest& req) const;
-    StringResponse HandleGetMapById(const StringRequest& req) const;
-    StringResponse HandleMoveDogs(const StringRequest& req);
+    ApiResponse HandleGetPlayers(const StringRequest& req);
+    ApiResponse HandleGetGameState(const StringRequest& req);
+    ApiResponse HandleGetMaps(const StringRequest& req) const;
+    ApiResponse HandleGetMapById(const StringRequest& req) const;
+    StringResponse HandleMoveDogs(const StringRequest& req, const app::SessionsGate::Pass& pass);
     StringResponse HandleGetRecords(const StringRequest& req) const;
     StringResponse HandleBadRequest (const StringRequest& req) const;
 
+    // Вызывать с доступом к сессиям
+    Strand GetPlayerStrand(const std::optional<players::Token>& token);
+    Strand GetSessionStrand(const model::GameSession* session);
+    static std::optional<players::Token> GetRequestToken(const StringRequest& req);
+
     app::Application& app_;
     Strand api_strand_;
+    std::mutex session_strands_mutex_;
+    std::unordered_map<const model::GameSession*, Strand> session_strands_;
+    std::shared_ptr<StateSnapshots> snapshots_;
+    std::shared_ptr<StatePublisher> publisher_;
+    MapResponses map_responses_;
     boost::asio::steady_timer move_dogs_timer_;
     std::optional<int> auto_ticket_;
     ExtraData& ex_data_;
 };
 
+template <typename Handler>
+void ApiHandler::AsyncHandleApiRequest(StringRequest&& req, Handler&& handler) {
+    const auto access = GetSessionsAccess(req.target());
+    const auto token = access == SessionsAccess::SHARED ? GetRequestToken(req) : std::nullopt;
+    auto run = [this, req = std::move(req), handler = std::forward<Handler>(handler)](app::SessionsGate::Pass pass) mutable {
+        handler(HandleApiRequest(req, pass));
+    };
+
+    auto& gate = app_.GetSessionsGate();
+    switch (access) {
+        case SessionsAccess::NONE:
+            boost::asio::dispatch(api_strand_, [run = std::move(run)]() mutable {
+                run({});
+            });
+            break;
+        case SessionsAccess::EXCLUSIVE:
+            gate.AsyncExclusive(api_strand_, std::move(run));
+            break;
+        case SessionsAccess::SHARED:
+            // strand игрока ищется по реестру игроков, поэтому уже с доступом
+            gate.AsyncShared(api_strand_.get_inner_executor(),
+                [this, token, run = std::move(run)](app::SessionsGate::Pass pass) mutable {
+                    boost::asio::dispatch(GetPlayerStrand(token), [run = std::move(run), pass = std::move(pass)]() mutable {
+                        run(std::move(pass));
+                    });
+                });
+            break;
+    }
+}
+
 
 class RequestHandler : public std::enable_shared_from_this<RequestHandler> {
 public:
-    using StaticFileResponse = std::variant<StringResponse, FileResponse>;
-
     explicit RequestHandler(Strand api_strand, model::Game& game, const char * static_file, app::Application& app, 
-        std::optional<int> auto_ticket, ExtraData& ex_data)
-        : api_strand_{api_strand}, game_{game}, static_file_(static_file), api_handler_{app, api_strand, auto_ticket, ex_data} {
+        std::optional<int> auto_ticket, ExtraData& ex_data,
+        uintmax_t sendfile_threshold = StaticFiles::DEFAULT_SENDFILE_THRESHOLD)
+        : api_strand_{api_strand}, game_{game}, static_file_(static_file), static_files_(static_file, sendfile_threshold)
+        , api_handler_{app, api_strand, auto_ticket, ex_data} {
     }
 
     RequestHandler(const RequestHandler&) = delete;
     RequestHandler& operator=(const RequestHandler&) = delete;
 
+    void HandleUpgrade(beast::tcp_stream&& stream, StringRequest&& req);
+
+    std::shared_ptr<StatePublisher> GetStatePublisher() const { return api_handler_.GetStatePublisher(); }
+
     template <typename Body, typename Allocator, typename Send>
     void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, boost::asio::ip::tcp::endpoint endpoint) {
         auto start_time = std::chrono::steady_clock::now();
@@ -117,32 +207,24 @@ public:
         }
 
         if (target.rfind("/api/", 0) == 0)  {
-            auto handle = [self = shared_from_this(), req = std::forward<decltype(req)>(req), send = std::forward<decltype(send)>(send), start_time] {
-                assert(self->api_strand_.running_in_this_thread());
-                auto response = self->HandleStringRequest(req);
-    
+            auto handle = [self = shared_from_this(), send = std::forward<decltype(send)>(send), start_time](ApiHandler::ApiResponse&& response) {
                 auto end_time = std::chrono::steady_clock::now();
                 auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
     
-                self->LoggingResponse(response, static_cast<int>(duration.count()));
-    
-                send(std::move(response));
+                std::visit([&send, &self, duration](auto&& arg) {
+                    self->LoggingResponse(arg, static_cast<int>(duration.count()));
+                    send(std::move(arg));
+                }, response);
             };
-            boost::asio::dispatch(api_strand_, handle);
+            api_handler_.AsyncHandleApiRequest(std::forward<decltype(req)>(req), std::move(handle));
         } else {
-            auto response = HandleStaticFileRequest(std::forward<decltype(req)>(req));
+            auto response = HandleStaticFileRequest(static_files_, req);
 
             std::visit([&send, start_time, this](auto&& arg) {
-                using T = std::decay_t<decltype(arg)>;
-                
                 auto end_time = std::chrono::steady_clock::now();
                 auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
                 
-                if constexpr (std::is_same_v<T, StringResponse>) {
-                    LoggingResponse(arg, static_cast<int>(duration.count()));
-                } else if constexpr (std::is_same_v<T, FileResponse>) {
-                    LoggingResponse(arg, static_cast<int>(duration.count()));
-                }
+                LoggingResponse(arg, static_cast<int>(duration.count()));
                 
                 send(std::move(arg));
             }, response);
@@ -150,12 +232,9 @@ public:
     }
 
 private:
-    StringResponse HandleStringRequest(const StringRequest& req);
-    StaticFileResponse HandleStaticFileRequest(StringRequest&& req);
-
     template <typename Req>
     void LoggingRequest(const Req& req, boost::asio::ip::tcp::endpoint endpoint) {
-        std::string_view uri = req.target();
+        const std::string uri = RedactTarget(req.target());
         std::string_view method = boost::beast::http::to_string(req.method());
 
         JsonLogger::LogJson(uri, method, endpoint);
@@ -173,6 +252,7 @@ private:
     Strand api_strand_;
     model::Game& game_;
     const char * static_file_;
+    StaticFiles static_files_;
     ApiHandler api_handler_;
 };
 
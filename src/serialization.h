@@ -4,6 +4,7 @@
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/unordered_map.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 #include <boost/serialization/optional.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
@@ -27,6 +28,13 @@ void serialize(Archive& ar, model::Velocity& vel, [[maybe_unused]] const unsigne
     ar & vel.dy;
 }
 
+// Сериализация для model::BagItem
+template <typename Archive>
+void serialize(Archive& ar, model::BagItem& item, [[maybe_unused]] const unsigned int version) {
+    ar & item.id;
+    ar & item.type;
+}
+
 // Сериализация для model::Direction
 template <typename Archive>
 void serialize(Archive& ar, model::Direction& dir, [[maybe_unused]] const unsigned int version) {
@@ -42,7 +50,7 @@ class BagRepr {
 public:
     BagRepr() = default;
     explicit BagRepr(const model::Bag& bag) 
-        : capacity_(bag.GetCapacity()), items_(bag.GetItems()) {}
+        : capacity_(bag.GetCapacity()), items_(bag.GetItems().begin(), bag.GetItems().end()) {}
 
     model::Bag Restore() const {
         model::Bag bag(capacity_);
@@ -53,14 +61,24 @@ public:
     }
 
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned int version) {
+    void serialize(Archive& ar, const unsigned int version) {
         ar & capacity_;
-        ar & items_;
+        if (version == 0) {
+            // До версии 1 рюкзак хранился как unordered_map id -> type
+            std::unordered_map<int, int> items;
+            ar & items;
+            items_.clear();
+            for (const auto& [id, type] : items) {
+                items_.push_back(model::BagItem{id, type});
+            }
+        } else {
+            ar & items_;
+        }
     }
 
 private:
     int capacity_;
-    std::unordered_map<int, int> items_;
+    std::vector<model::BagItem> items_;
 };
 
 // Сериализация для model::Dog
@@ -77,12 +95,8 @@ public:
           points_(dog.GetPoints()) {}
 
     model::Dog Restore() const {
-        model::Bag bag = bag_.Restore();
-        model::Dog dog(name_, id_, bag.GetCapacity(), position_, velocity_, direction_);
-        
-        for(auto& [id, type] : bag.GetItems()) {
-            dog.GetBag().AddItem(id, type);
-        }
+        model::Dog dog(name_, id_, 0, position_, velocity_, direction_);
+        dog.GetBag() = bag_.Restore();
 
         dog.AddPoints(points_);
         return dog;
@@ -138,39 +152,51 @@ class PlayerRepr {
 public:
     PlayerRepr() = default;
     explicit PlayerRepr(const players::Player& player)
-        : session_dog_id_(player.ConstGetDog()->GetId()),
+        : session_dog_id_(player.GetPlayerDogId()),
           session_map_id_(*player.GetSession()->GetMap()->GetId()),
-          token_(player.GetToken()),
+          session_instance_(player.GetSession()->GetInstance()),
+          token_(player.GetToken().ToString()),
           id_(player.GetId()) {}
 
     std::shared_ptr<players::Player> Restore(model::Game& game) const {
-        auto session = game.GetSession(model::Map::Id(session_map_id_));
+        auto session = game.FindSession(model::Map::Id(session_map_id_), session_instance_);
         if (!session) {
             throw std::runtime_error("Session not found during deserialization");
         }
 
-        auto dog = session->GetDog(session_dog_id_);
-        if (!dog) {
+        const model::DogHandle dog{session_dog_id_};
+        if (!session->GetDog(dog)) {
             throw std::runtime_error("Dog not found during deserialization");
         }
 
+        auto token = players::Token::Parse(token_);
+        if (!token) {
+            throw std::runtime_error("Invalid player token during deserialization");
+        }
+
         auto player = std::make_shared<players::Player>(dog, session, id_);
-        player->AddToken(token_);
+        player->AddToken(*token);
         return player;
     }
 
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned int version) {
+    void serialize(Archive& ar, const unsigned int version) {
         ar & session_dog_id_;
         ar & session_map_id_;
         ar & token_;
         ar & id_;
+        // До версии 1 у карты была единственная сессия
+        if (version >= 1) {
+            ar & session_instance_;
+        }
     }
 
 private:
     uint32_t session_dog_id_;
     std::string session_map_id_;
-    players::Token token_;
+    size_t session_instance_ = 0;
+    // Токен хранится строкой, как его видит клиент
+    std::string token_;
     uint32_t id_;
 };
 
@@ -185,14 +211,9 @@ public:
     }
 
     void Restore(model::Game& game, players::Players& players) const {
-        std::vector<std::shared_ptr<players::Player>> ready_players;
-
         for (auto& player : players_) {
-            auto ready_player = player.Restore(game);
-            players.AddPlayerWithToken(ready_player, ready_player->GetToken());
-            ready_players.push_back(ready_player);
+            players.RestorePlayer(player.Restore(game));
         }
-        players.SetPlayers(std::move(ready_players));
 
         players.SetNextPlayerId(next_id_player_);
     }
@@ -216,30 +237,29 @@ public:
         : id_map_(*session.GetMap()->GetId()),
         next_id_dog_(session.GetNextIdDog()),
         next_id_loot_(session.GetNextIdLoot()) {
-        for (auto& [id, dog] : session.GetDogs()){
-            dogs_.push_back(DogRepr(*dog));
+        const auto& dogs = session.GetDogs();
+        for (size_t i = 0; i < dogs.Size(); ++i) {
+            dogs_.push_back(DogRepr(dogs.Get(i)));
         }
-        for (auto& [id, loot] : session.GetLoots()){
-            loots_.push_back(LootRepr(*loot));
+        for (const auto& loot : session.GetLoots().GetValues()) {
+            loots_.push_back(LootRepr(loot));
         }
     }
 
-    model::GameSession Restore(model::Game& game) const {
-        auto mapPtr = std::make_shared<model::Map>(*game.FindMap(model::Map::Id{id_map_}));
-        model::GameSession session (mapPtr, game.GetSpawnPoints());
-        std::unordered_map<uint32_t, std::shared_ptr<model::Dog>> ready_dogs;
-        std::unordered_map<int, std::shared_ptr<model::Loot>> ready_loots;
+    const std::string& GetMapId() const noexcept {
+        return id_map_;
+    }
 
+    model::GameSession Restore(model::Game& game, std::shared_ptr<model::Map> map, size_t instance) const {
+        // Состояние генератора не сохраняется: он начинает заново от seed игры
+        const auto seed = game.MakeSessionSeed(model::Map::Id{id_map_}, instance);
+        model::GameSession session (std::move(map), game.GetSpawnPoints(), instance, seed);
         for (auto& dog : dogs_) {
-            auto ready_dog = std::make_shared<model::Dog>(dog.Restore());
-            ready_dogs[ready_dog->GetId()] = ready_dog;
+            session.RestoreDog(dog.Restore());
         }
         for (auto& loot : loots_) {
-            auto ready_loot = std::make_shared<model::Loot>(loot.Restore());
-            ready_loots[ready_loot->GetId()] = ready_loot;
+            session.RestoreLoot(loot.Restore());
         }
-        session.SetReadyDogs(std::move(ready_dogs));
-        session.SetReadyLoots(std::move(ready_loots));
         session.SetNextIdDog(next_id_dog_);
         session.SetNextIdLoot(next_id_loot_);
 
@@ -268,8 +288,11 @@ public:
     GameSessionsAndPlayersRepr() = default;
     explicit GameSessionsAndPlayersRepr(const model::Game::GameSessions& sessions, const players::Players& players) 
     : players_(players) {
-        for (auto& [id_map, session] : sessions){
-            sessions_.push_back(GameSessionRepr(*session));
+        // Экземпляры одной карты сохраняются подряд в порядке номеров
+        for (auto& [id_map, instances] : sessions){
+            for (const auto& session : instances) {
+                sessions_.push_back(GameSessionRepr(*session));
+            }
         }
     }
 
@@ -277,10 +300,16 @@ public:
         model::Game::GameSessions sessions;
 
         for (auto& session : sessions_) {
-            auto ready_session = std::make_shared<model::GameSession>(session.Restore(game));
-            sessions[ready_session->GetMap()->GetId()] = ready_session;
+            const model::Map::Id id_map{session.GetMapId()};
+            const model::Map* map = game.FindMap(id_map);
+            if (!map) {
+                throw std::runtime_error("Map not found during deserialization");
+            }
+            auto& instances = sessions[id_map];
+            auto map_ptr = instances.empty() ? std::make_shared<model::Map>(*map) : instances.front()->GetMap();
+            instances.push_back(std::make_shared<model::GameSession>(session.Restore(game, map_ptr, instances.size())));
         }
-        game.SetGameSessions(sessions);
+        game.SetGameSessions(std::move(sessions));
 
         players_.Restore(game, players);
     }
@@ -296,4 +325,7 @@ private:
     PlayersRepr players_;
 };
 
-} // namespace serialization
\ No newline at end of file
+} // namespace serialization
+
+BOOST_CLASS_VERSION(::serialization::BagRepr, 1)
+BOOST_CLASS_VERSION(::serialization::PlayerRepr, 1)
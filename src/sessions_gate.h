@@ -0,0 +1,236 @@
+#pragma once
+
+#include <boost/asio/post.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace app {
+
+// Доступ к сессиям и реестру игроков. Тик и вход в игру получают его монопольно, запросы к сессиям — совместно.
+// Ожидающий не занимает поток: его обработчик встаёт в очередь и уходит на свой executor, когда доступ открыт.
+// Очередь общая, поэтому ожидающий монопольный доступ не пропускает вперёд новых читателей и тик не голодает
+class SessionsGate {
+public:
+    // Выданный доступ, возвращается в деструкторе
+    class Pass {
+    public:
+        Pass() = default;
+
+        Pass(Pass&& other) noexcept
+            : gate_(std::exchange(other.gate_, nullptr)), exclusive_(other.exclusive_) {
+        }
+
+        Pass& operator=(Pass&& other) noexcept {
+            if (this != &other) {
+                Release();
+                gate_ = std::exchange(other.gate_, nullptr);
+                exclusive_ = other.exclusive_;
+            }
+            return *this;
+        }
+
+        ~Pass() {
+            Release();
+        }
+
+        explicit operator bool() const noexcept {
+            return gate_ != nullptr;
+        }
+
+        bool IsExclusive() const noexcept {
+            return gate_ != nullptr && exclusive_;
+        }
+
+        void Release() {
+            if (gate_) {
+                std::exchange(gate_, nullptr)->Release(exclusive_);
+            }
+        }
+
+    private:
+        friend class SessionsGate;
+
+        Pass(SessionsGate* gate, bool exclusive) noexcept
+            : gate_(gate), exclusive_(exclusive) {
+        }
+
+        SessionsGate* gate_ = nullptr;
+        bool exclusive_ = false;
+    };
+
+    SessionsGate() = default;
+    SessionsGate(const SessionsGate&) = delete;
+    SessionsGate& operator=(const SessionsGate&) = delete;
+
+    // Отправляет handler(Pass) на executor, когда сессии можно читать
+    template <typename Executor, typename Handler>
+    void AsyncShared(const Executor& executor, Handler&& handler) {
+        Acquire(std::make_unique<AsyncWaiter<Executor, std::decay_t<Handler>>>(
+            false, executor, std::forward<Handler>(handler)));
+    }
+
+    // Отправляет handler(Pass) на executor, когда сессии можно менять
+    template <typename Executor, typename Handler>
+    void AsyncExclusive(const Executor& executor, Handler&& handler) {
+        Acquire(std::make_unique<AsyncWaiter<Executor, std::decay_t<Handler>>>(
+            true, executor, std::forward<Handler>(handler)));
+    }
+
+    // Ждут доступа, блокируя поток, — для бенчмарков и тестов, но не для потоков io_context.
+    // Свободный доступ выдаётся без выделения памяти. После Close возвращают пустой Pass
+    Pass LockShared() {
+        return Lock(false);
+    }
+
+    Pass LockExclusive() {
+        return Lock(true);
+    }
+
+    // Отменяет ожидающих и больше не выдаёт доступ. Вызывается при остановке сервера,
+    // пока живы исполнители, на которые ожидающие отправили бы свои обработчики
+    void Close() {
+        std::deque<std::unique_ptr<Waiter>> cancelled;
+        {
+            std::lock_guard lock{mutex_};
+            closed_ = true;
+            cancelled.swap(waiters_);
+        }
+    }
+
+private:
+    struct Waiter {
+        explicit Waiter(bool exclusive) : exclusive(exclusive) {}
+        virtual ~Waiter() = default;
+        virtual void Resume(Pass pass) = 0;
+
+        bool exclusive;
+    };
+
+    template <typename Executor, typename Handler>
+    struct AsyncWaiter : Waiter {
+        template <typename H>
+        AsyncWaiter(bool exclusive, const Executor& executor, H&& handler)
+            : Waiter(exclusive), executor(executor), handler(std::forward<H>(handler)) {
+        }
+
+        void Resume(Pass pass) override {
+            boost::asio::post(executor, [handler = std::move(handler), pass = std::move(pass)]() mutable {
+                handler(std::move(pass));
+            });
+        }
+
+        Executor executor;
+        Handler handler;
+    };
+
+    // Поток ждёт на переменной условия. Отменённый Close ожидающий получает пустой Pass
+    struct BlockingWaiter : Waiter {
+        struct Slot {
+            std::mutex mutex;
+            std::condition_variable cv;
+            Pass pass;
+            bool ready = false;
+        };
+
+        BlockingWaiter(bool exclusive, Slot& slot) : Waiter(exclusive), slot(slot) {}
+
+        ~BlockingWaiter() override {
+            if (!resumed) {
+                Resume({});
+            }
+        }
+
+        void Resume(Pass pass) override {
+            resumed = true;
+            std::lock_guard lock{slot.mutex};
+            slot.pass = std::move(pass);
+            slot.ready = true;
+            slot.cv.notify_one();
+        }
+
+        Slot& slot;
+        bool resumed = false;
+    };
+
+    bool CanEnter(bool exclusive) const noexcept {
+        return exclusive ? !writer_ && readers_ == 0 : !writer_;
+    }
+
+    void Enter(bool exclusive) noexcept {
+        if (exclusive) {
+            writer_ = true;
+        } else {
+            ++readers_;
+        }
+    }
+
+    void Acquire(std::unique_ptr<Waiter> waiter) {
+        {
+            std::lock_guard lock{mutex_};
+            if (closed_) {
+                return;
+            }
+            if (!waiters_.empty() || !CanEnter(waiter->exclusive)) {
+                waiters_.push_back(std::move(waiter));
+                return;
+            }
+            Enter(waiter->exclusive);
+        }
+        waiter->Resume(Pass{this, waiter->exclusive});
+    }
+
+    Pass Lock(bool exclusive) {
+        {
+            std::lock_guard lock{mutex_};
+            if (closed_) {
+                return {};
+            }
+            if (waiters_.empty() && CanEnter(exclusive)) {
+                Enter(exclusive);
+                return Pass{this, exclusive};
+            }
+        }
+
+        BlockingWaiter::Slot slot;
+        Acquire(std::make_unique<BlockingWaiter>(exclusive, slot));
+        std::unique_lock lock{slot.mutex};
+        slot.cv.wait(lock, [&slot] { return slot.ready; });
+        return std::move(slot.pass);
+    }
+
+    void Release(bool exclusive) {
+        std::vector<std::unique_ptr<Waiter>> granted;
+        {
+            std::lock_guard lock{mutex_};
+            if (exclusive) {
+                writer_ = false;
+            } else {
+                --readers_;
+            }
+            while (!closed_ && !waiters_.empty() && CanEnter(waiters_.front()->exclusive)) {
+                Enter(waiters_.front()->exclusive);
+                granted.push_back(std::move(waiters_.front()));
+                waiters_.pop_front();
+            }
+        }
+        // Обработчики уходят на свои исполнители уже без мьютекса
+        for (auto& waiter : granted) {
+            waiter->Resume(Pass{this, waiter->exclusive});
+        }
+    }
+
+    std::mutex mutex_;
+    size_t readers_ = 0;
+    bool writer_ = false;
+    bool closed_ = false;
+    std::deque<std::unique_ptr<Waiter>> waiters_;
+};
+
+}  // namespace app
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace util {
+
+// Ключ слота: индекс слота и его поколение. Поколение слота увеличивается
+// при каждом удалении, поэтому ключ удалённого элемента становится недействительным
+struct SlotKey {
+    uint32_t index = 0;
+    uint32_t generation = 0;
+
+    auto operator<=>(const SlotKey&) const = default;
+};
+
+// Контейнер с O(1) вставкой, удалением и поиском по ключу. Значения хранятся
+// плотно в одном массиве, удаление переносит последнее значение на место удалённого
+template <typename T>
+class SlotMap {
+public:
+    using Key = SlotKey;
+
+    size_t Size() const noexcept {
+        return values_.size();
+    }
+
+    bool Empty() const noexcept {
+        return values_.empty();
+    }
+
+    Key Insert(T value) {
+        uint32_t index;
+        if (free_head_ != NO_SLOT) {
+            index = free_head_;
+            free_head_ = slots_[index].position;
+        } else {
+            index = static_cast<uint32_t>(slots_.size());
+            slots_.push_back({});
+        }
+        slots_[index].position = static_cast<uint32_t>(values_.size());
+
+        const Key key{index, slots_[index].generation};
+        values_.push_back(std::move(value));
+        keys_.push_back(key);
+        return key;
+    }
+
+    bool Remove(Key key) {
+        if (!Contains(key)) {
+            return false;
+        }
+        Slot& slot = slots_[key.index];
+        const uint32_t position = slot.position;
+        const uint32_t last = static_cast<uint32_t>(values_.size() - 1);
+        if (position != last) {
+            values_[position] = std::move(values_[last]);
+            keys_[position] = keys_[last];
+            slots_[keys_[position].index].position = position;
+        }
+        values_.pop_back();
+        keys_.pop_back();
+
+        ++slot.generation;
+        slot.position = free_head_;
+        free_head_ = key.index;
+        return true;
+    }
+
+    bool Contains(Key key) const noexcept {
+        return key.index < slots_.size() && slots_[key.index].generation == key.generation
+            && slots_[key.index].position < values_.size() && keys_[slots_[key.index].position] == key;
+    }
+
+    T* Find(Key key) noexcept {
+        return Contains(key) ? &values_[slots_[key.index].position] : nullptr;
+    }
+
+    const T* Find(Key key) const noexcept {
+        return Contains(key) ? &values_[slots_[key.index].position] : nullptr;
+    }
+
+    void Clear() {
+        while (!keys_.empty()) {
+            Remove(keys_.back());
+        }
+    }
+
+    // Плотные массивы значений и их ключей: i-й ключ соответствует i-му значению
+    std::span<const T> GetValues() const noexcept {
+        return values_;
+    }
+
+    std::span<const Key> GetKeys() const noexcept {
+        return keys_;
+    }
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    struct Slot {
+        // Позиция значения в values_ для занятого слота, следующий свободный слот — для свободного
+        uint32_t position = NO_SLOT;
+        uint32_t generation = 0;
+    };
+
+    std::vector<Slot> slots_;
+    std::vector<T> values_;
+    std::vector<Key> keys_;
+    uint32_t free_head_ = NO_SLOT;
+};
+
+}  // namespace util
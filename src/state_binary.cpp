@@ -0,0 +1,124 @@
+#include "state_binary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace http_handler::state_binary {
+
+namespace {
+
+// Пишет значение побайтово, поэтому порядок байт не зависит от платформы
+class Writer {
+public:
+    explicit Writer(std::string& out) : pos_(out.data()) {}
+
+    template <typename T>
+    void Put(T value) {
+        auto bits = static_cast<std::make_unsigned_t<T>>(value);
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            *pos_++ = static_cast<char>(bits & 0xFF);
+            bits = static_cast<std::make_unsigned_t<T>>(bits >> 8);
+        }
+    }
+
+    void PutBytes(std::string_view bytes) {
+        pos_ = std::copy(bytes.begin(), bytes.end(), pos_);
+    }
+
+private:
+    char* pos_;
+};
+
+uint16_t BagItemCount(const model::Bag& bag) {
+    return static_cast<uint16_t>(std::min<size_t>(bag.GetSize(), std::numeric_limits<uint16_t>::max()));
+}
+
+}  // namespace
+
+int32_t Quantize(double value) noexcept {
+    constexpr double MIN = std::numeric_limits<int32_t>::min();
+    constexpr double MAX = std::numeric_limits<int32_t>::max();
+    return static_cast<int32_t>(std::clamp(std::round(value * FIXED_POINT_SCALE), MIN, MAX));
+}
+
+std::string BuildState(const model::GameSession& session) {
+    const auto& dogs = session.GetDogs();
+    const auto& loots = session.GetLoots().GetValues();
+
+    size_t bag_items = 0;
+    for (const auto& bag : dogs.GetBags()) {
+        bag_items += BagItemCount(bag);
+    }
+
+    std::string out(STATE_HEADER_SIZE + dogs.Size() * PLAYER_RECORD_SIZE + bag_items * BAG_ITEM_RECORD_SIZE
+                    + loots.size() * LOOT_RECORD_SIZE, '\0');
+    Writer writer{out};
+
+    writer.PutBytes("DGST");
+    writer.Put<uint16_t>(VERSION);
+    writer.Put<uint16_t>(0);
+    writer.Put<uint64_t>(session.GetTick());
+    writer.Put<uint32_t>(static_cast<uint32_t>(dogs.Size()));
+    writer.Put<uint32_t>(static_cast<uint32_t>(loots.size()));
+    writer.Put<uint32_t>(static_cast<uint32_t>(bag_items));
+
+    for (size_t i = 0; i < dogs.Size(); ++i) {
+        const auto& position = dogs.GetPositions()[i];
+        const auto& velocity = dogs.GetVelocities()[i];
+        writer.Put<uint32_t>(dogs.GetIds()[i]);
+        writer.Put<int32_t>(Quantize(position.x));
+        writer.Put<int32_t>(Quantize(position.y));
+        writer.Put<int32_t>(Quantize(velocity.dx));
+        writer.Put<int32_t>(Quantize(velocity.dy));
+        writer.Put<int32_t>(dogs.GetPoints()[i]);
+        writer.Put<uint16_t>(BagItemCount(dogs.GetBags()[i]));
+        writer.Put<uint8_t>(static_cast<uint8_t>(dogs.GetDirections()[i]));
+        writer.Put<uint8_t>(0);
+    }
+
+    for (const auto& bag : dogs.GetBags()) {
+        for (const auto& item : bag.GetItems().first(BagItemCount(bag))) {
+            writer.Put<uint32_t>(static_cast<uint32_t>(item.id));
+            writer.Put<uint32_t>(static_cast<uint32_t>(item.type));
+        }
+    }
+
+    for (const auto& loot : loots) {
+        writer.Put<uint32_t>(static_cast<uint32_t>(loot.GetId()));
+        writer.Put<uint32_t>(static_cast<uint32_t>(loot.GetType()));
+        writer.Put<int32_t>(Quantize(loot.GetPosition().x));
+        writer.Put<int32_t>(Quantize(loot.GetPosition().y));
+    }
+
+    return out;
+}
+
+std::string BuildPlayers(const model::GameSession& session) {
+    const auto& dogs = session.GetDogs();
+
+    size_t names_size = 0;
+    for (const auto& name : dogs.GetNames()) {
+        names_size += name.size();
+    }
+
+    std::string out(PLAYERS_HEADER_SIZE + dogs.Size() * PLAYER_NAME_RECORD_SIZE + names_size, '\0');
+    Writer writer{out};
+
+    writer.PutBytes("DGPL");
+    writer.Put<uint16_t>(VERSION);
+    writer.Put<uint16_t>(0);
+    writer.Put<uint32_t>(static_cast<uint32_t>(dogs.Size()));
+
+    for (size_t i = 0; i < dogs.Size(); ++i) {
+        writer.Put<uint32_t>(dogs.GetIds()[i]);
+        writer.Put<uint32_t>(static_cast<uint32_t>(dogs.GetNames()[i].size()));
+    }
+    for (const auto& name : dogs.GetNames()) {
+        writer.PutBytes(name);
+    }
+
+    return out;
+}
+
+}  // namespace http_handler::state_binary
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "model.h"
+
+namespace http_handler {
+
+// Двоичные тела /game/state и /game/players для клиентов, приславших Accept с MEDIA_TYPE.
+// Числа little-endian, записи фиксированной длины, координаты и скорости — целые в сотых долях.
+// Раскладка описана вместе с декодером в static/js/state_binary.js
+namespace state_binary {
+
+constexpr uint16_t VERSION = 1;
+constexpr double FIXED_POINT_SCALE = 100.0;
+
+// "DGST": version u16, reserved u16, tick u64, players u32, loots u32, bag items u32
+constexpr size_t STATE_HEADER_SIZE = 28;
+// id u32, x i32, y i32, dx i32, dy i32, score i32, bag items u16, dir u8, reserved u8
+constexpr size_t PLAYER_RECORD_SIZE = 28;
+// id u32, type u32. Предметы всех рюкзаков подряд в порядке игроков
+constexpr size_t BAG_ITEM_RECORD_SIZE = 8;
+// id u32, type u32, x i32, y i32
+constexpr size_t LOOT_RECORD_SIZE = 16;
+
+// "DGPL": version u16, reserved u16, players u32, затем записи и имена в UTF-8 подряд
+constexpr size_t PLAYERS_HEADER_SIZE = 12;
+// id u32, длина имени в байтах u32
+constexpr size_t PLAYER_NAME_RECORD_SIZE = 8;
+
+// Координата в фиксированной точке, вне диапазона int32 насыщается
+int32_t Quantize(double value) noexcept;
+
+// Собираются прямо из DogStore и трофеев сессии, без промежуточного дерева
+std::string BuildState(const model::GameSession& session);
+std::string BuildPlayers(const model::GameSession& session);
+
+}  // namespace state_binary
+
+}  // namespace http_handler
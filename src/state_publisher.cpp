@@ -0,0 +1,59 @@
+#include "state_publisher.h"
+
+namespace http_handler {
+
+void StatePublisher::Subscribe(std::shared_ptr<model::GameSession> session, const players::Token& token,
+                               const Connection& connection) {
+    connection->Send(snapshots_->GetState(*session));
+
+    std::lock_guard lock{mutex_};
+    auto& topic = topics_[session.get()];
+    topic.session = std::move(session);
+    topic.subscribers.push_back({token, connection});
+}
+
+void StatePublisher::OnTick([[maybe_unused]] std::chrono::milliseconds delta) {
+    std::lock_guard lock{mutex_};
+    for (auto it = topics_.begin(); it != topics_.end();) {
+        auto& topic = it->second;
+        // Закрытые соединения и игроки, ушедшие из игры, выбывают из рассылки
+        std::erase_if(topic.subscribers, [this, &topic](const Subscriber& subscriber) {
+            auto connection = subscriber.connection.lock();
+            if (!connection || !connection->IsOpen()) {
+                return true;
+            }
+            if (app_.FindPlayerSession(subscriber.token) != topic.session) {
+                connection->Close();
+                return true;
+            }
+            return false;
+        });
+
+        if (topic.subscribers.empty()) {
+            it = topics_.erase(it);
+            continue;
+        }
+
+        auto frame = snapshots_->GetState(*topic.session);
+        for (const auto& subscriber : topic.subscribers) {
+            if (auto connection = subscriber.connection.lock()) {
+                connection->Send(frame);
+            }
+        }
+        ++it;
+    }
+}
+
+void StatePublisher::OnShutdown() {
+    std::lock_guard lock{mutex_};
+    for (auto& [session, topic] : topics_) {
+        for (const auto& subscriber : topic.subscribers) {
+            if (auto connection = subscriber.connection.lock()) {
+                connection->Close(http_server::websocket::close_code::going_away);
+            }
+        }
+    }
+    topics_.clear();
+}
+
+}  // namespace http_handler
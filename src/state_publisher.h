@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "application.h"
+#include "http_server.h"
+#include "state_snapshots.h"
+
+namespace http_handler {
+
+// Рассылает состояние сессии подписчикам WebSocket после каждого тика.
+// Тело собирается один раз на сессию, всем её подписчикам уходит один и тот же буфер
+class StatePublisher : public app::ApplicationListener {
+public:
+    using Connection = std::shared_ptr<http_server::WebSocketSession>;
+
+    StatePublisher(app::Application& app, std::shared_ptr<StateSnapshots> snapshots)
+        : app_(app), snapshots_(std::move(snapshots)) {}
+
+    // Вызывать с совместным доступом к сессиям на strand сессии. Подписчик сразу получает текущее состояние
+    void Subscribe(std::shared_ptr<model::GameSession> session, const players::Token& token, const Connection& connection);
+
+    // Application::Tick вызывает с монопольным доступом к сессиям
+    void OnTick(std::chrono::milliseconds delta) override;
+    void OnShutdown() override;
+
+private:
+    struct Subscriber {
+        players::Token token;
+        std::weak_ptr<http_server::WebSocketSession> connection;
+    };
+
+    struct Topic {
+        std::shared_ptr<model::GameSession> session;
+        std::vector<Subscriber> subscribers;
+    };
+
+    app::Application& app_;
+    std::shared_ptr<StateSnapshots> snapshots_;
+    std::mutex mutex_;
+    std::unordered_map<const model::GameSession*, Topic> topics_;
+};
+
+}  // namespace http_handler
@@ -0,0 +1,152 @@
+#include "state_snapshots.h"
+#include "state_binary.h"
+
+#include <boost/json.hpp>
+#include <cmath>
+
+namespace http_handler {
+
+using namespace boost::json;
+
+namespace {
+
+double FormatDouble(double value) {
+    double roundedNumber = std::round(value * 100.0) / 100.0;
+    return roundedNumber;
+}
+
+object PlayerToJson(const model::DogStore& dogs, size_t i) {
+    const auto& position = dogs.GetPositions()[i];
+    const auto& velocity = dogs.GetVelocities()[i];
+
+    object player_obj;
+    player_obj["pos"] = {FormatDouble(position.x), FormatDouble(position.y)};
+    player_obj["speed"] = {FormatDouble(velocity.dx),FormatDouble(velocity.dy)};
+    player_obj["dir"] = model::DirectionToString(dogs.GetDirections()[i]);
+
+    array bag_player;
+    for (const auto& [id, type] : dogs.GetBags()[i].GetItems()) {
+        object loot_obj;
+        loot_obj["id"] = id;
+        loot_obj["type"] = type;
+        bag_player.push_back(loot_obj);
+    }
+    player_obj["bag"] = bag_player;
+
+    player_obj["score"] = dogs.GetPoints()[i];
+    return player_obj;
+}
+
+object LootToJson(const model::Loot& loot) {
+    object loot_obj;
+    loot_obj["type"] = loot.GetType();
+    loot_obj["pos"] = {FormatDouble(loot.GetPosition().x), FormatDouble(loot.GetPosition().y)};
+    return loot_obj;
+}
+
+// Собаки и трофеи, изменившиеся после тика since. При since == 0 — все
+object ChangedStateJson(const model::GameSession& session, uint64_t since) {
+    const auto& dogs = session.GetDogs();
+    object players_json;
+    for (size_t i = 0; i < dogs.Size(); ++i) {
+        if (dogs.GetChangeTicks()[i] > since) {
+            players_json[std::to_string(dogs.GetIds()[i])] = PlayerToJson(dogs, i);
+        }
+    }
+
+    object loots_json;
+    for (const auto& loot : session.GetLoots().GetValues()) {
+        if (loot.GetAddedTick() > since) {
+            loots_json[std::to_string(loot.GetId())] = LootToJson(loot);
+        }
+    }
+
+    return {{"players", players_json}, {"lostObjects", loots_json}};
+}
+
+array RemovedIdsJson(const std::vector<model::GameSession::Removal>& removals, uint64_t since) {
+    array ids;
+    for (const auto& removal : removals) {
+        if (removal.tick > since) {
+            ids.push_back(removal.id);
+        }
+    }
+    return ids;
+}
+
+}  // namespace
+
+std::string BuildStateJson(const model::GameSession& session) {
+    const auto& dogs = session.GetDogs();
+    object players_json;
+    for (size_t i = 0; i < dogs.Size(); ++i) {
+        players_json[std::to_string(dogs.GetIds()[i])] = PlayerToJson(dogs, i);
+    }
+
+    object loots_json;
+    for (const auto& loot : session.GetLoots().GetValues()) {
+        loots_json[std::to_string(loot.GetId())] = LootToJson(loot);
+    }
+
+    object response = {{"players", players_json}, {"lostObjects", loots_json}};
+    return serialize(response);
+}
+
+std::string BuildStateDeltaJson(const model::GameSession& session, uint64_t epoch, uint64_t since) {
+    const bool full = !session.CanDeltaSince(epoch, since);
+    object response = ChangedStateJson(session, full ? 0 : since);
+    // Полная картина заменяет состояние клиента целиком, списки удалений ей не нужны
+    response["removedPlayers"] = full ? array{} : RemovedIdsJson(session.GetRemovedDogs(), since);
+    response["removedObjects"] = full ? array{} : RemovedIdsJson(session.GetRemovedLoots(), since);
+    response["tick"] = session.GetTick();
+    response["epoch"] = model::GameSession::GetEpoch();
+    response["full"] = full;
+    return serialize(response);
+}
+
+std::string BuildPlayersJson(const model::GameSession& session) {
+    const auto& dogs = session.GetDogs();
+    object response;
+    for (size_t i = 0; i < dogs.Size(); ++i) {
+        object player_object;
+        player_object["name"] = dogs.GetNames()[i];
+        response[std::to_string(dogs.GetIds()[i])] = std::move(player_object);
+    }
+    return serialize(response);
+}
+
+template <typename Build>
+StateSnapshots::Buffer StateSnapshots::Get(const model::GameSession& session, Snapshot Entry::*snapshot, Build build) {
+    const uint64_t version = session.GetStateVersion();
+    {
+        std::lock_guard lock{mutex_};
+        const Snapshot& cached = entries_[&session].*snapshot;
+        if (cached.body && cached.version == version) {
+            return cached.body;
+        }
+    }
+
+    // Сборка идёт без мьютекса: у запроса совместный доступ к сессии, до его конца она не изменится
+    auto body = std::make_shared<const std::string>(build(session));
+    std::lock_guard lock{mutex_};
+    entries_[&session].*snapshot = Snapshot{version, body};
+    return body;
+}
+
+StateSnapshots::Buffer StateSnapshots::GetState(const model::GameSession& session) {
+    return Get(session, &Entry::state, BuildStateJson);
+}
+
+StateSnapshots::Buffer StateSnapshots::GetPlayers(const model::GameSession& session) {
+    return Get(session, &Entry::players, BuildPlayersJson);
+}
+
+StateSnapshots::Buffer StateSnapshots::GetStateBinary(const model::GameSession& session) {
+    return Get(session, &Entry::state_binary, state_binary::BuildState);
+}
+
+StateSnapshots::Buffer StateSnapshots::GetPlayersBinary(const model::GameSession& session) {
+    return Get(session, &Entry::players_binary, state_binary::BuildPlayers);
+}
+
+}  // namespace http_handler
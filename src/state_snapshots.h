@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "model.h"
+
+namespace http_handler {
+
+// Тела ответов /game/state и /game/players в JSON и двоичном виде, собранные один раз
+// на версию состояния сессии. Собираются лениво при первом чтении, все запросы
+// до следующего изменения сессии получают один и тот же неизменяемый буфер
+class StateSnapshots {
+public:
+    using Buffer = std::shared_ptr<const std::string>;
+
+    // Вызывать с совместным доступом к сессиям
+    Buffer GetState(const model::GameSession& session);
+    Buffer GetPlayers(const model::GameSession& session);
+    Buffer GetStateBinary(const model::GameSession& session);
+    Buffer GetPlayersBinary(const model::GameSession& session);
+
+private:
+    struct Snapshot {
+        uint64_t version = 0;
+        Buffer body;
+    };
+
+    struct Entry {
+        Snapshot state;
+        Snapshot players;
+        Snapshot state_binary;
+        Snapshot players_binary;
+    };
+
+    template <typename Build>
+    Buffer Get(const model::GameSession& session, Snapshot Entry::*snapshot, Build build);
+
+    std::mutex mutex_;
+    std::unordered_map<const model::GameSession*, Entry> entries_;
+};
+
+std::string BuildStateJson(const model::GameSession& session);
+// Изменения после тика since: изменённые и новые собаки и трофеи, id удалённых, номер текущего тика и эпоха.
+// Если эпоха не совпала или since вне истории сессии, отдаётся полное состояние с "full": true
+std::string BuildStateDeltaJson(const model::GameSession& session, uint64_t epoch, uint64_t since);
+std::string BuildPlayersJson(const model::GameSession& session);
+
+}  // namespace http_handler
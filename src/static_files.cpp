@@ -0,0 +1,190 @@
+#include "static_files.h"
+#include "http_cache.h"
+#include "request_handler.h"
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <optional>
+
+namespace http_handler {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::unordered_map<std::string, std::string_view> content_types = {
+    {"html", ContentType::TEXT_HTML}, {"htm", ContentType::TEXT_HTML},
+    {"css", ContentType::TEXT_CSS},
+    {"txt", ContentType::TEXT_PLAIN},
+    {"js", ContentType::TEXT_JS},
+    {"json", ContentType::APPLICATION_JSON},
+    {"xml", ContentType::APPLICATION_XML},
+    {"png", ContentType::IMAGE_PNG},
+    {"jpg", ContentType::IMAGE_JPEG}, {"jpeg", ContentType::IMAGE_JPEG}, {"jpe", ContentType::IMAGE_JPEG},
+    {"gif", ContentType::IMAGE_GIF},
+    {"bmp", ContentType::IMAGE_BMP},
+    {"ico", ContentType::IMAGE_VND_MICROSOFT_ICON},
+    {"tiff", ContentType::IMAGE_TIFF}, {"tif", ContentType::IMAGE_TIFF},
+    {"svg", ContentType::IMAGE_SVG_XML}, {"svgz", ContentType::IMAGE_SVG_XML},
+    {"mp3", ContentType::AUDIO_MPEG}
+};
+
+std::string ToLower(const std::string& str) {
+    std::string lower_str = str;
+    std::transform(lower_str.begin(), lower_str.end(), lower_str.begin(), ::tolower);
+    return lower_str;
+}
+
+std::string GetFileExtension(const std::string_view filename) {
+    size_t dot_pos = filename.rfind('.');
+
+    if (dot_pos != std::string::npos && dot_pos != 0) {
+        return ToLower(std::string(filename).substr(dot_pos + 1));
+    }
+    return "";
+}
+
+// Сжимать имеет смысл только текст, картинки и звук уже сжаты
+bool IsCompressible(std::string_view content_type) {
+    return content_type.starts_with("text/") || content_type == ContentType::APPLICATION_JSON
+        || content_type == ContentType::APPLICATION_XML || content_type == ContentType::IMAGE_SVG_XML;
+}
+
+// Оба пути канонические, поэтому достаточно сравнить их поэлементно
+bool IsUnder(const fs::path& path, const fs::path& base) {
+    auto p = path.begin();
+    for (auto b = base.begin(); b != base.end(); ++b, ++p) {
+        if (p == path.end() || *p != *b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// nullopt, если файл не открылся или чтение оборвалось
+std::optional<std::string> ReadFile(const fs::path& path, uintmax_t size) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+    std::string content(size, '\0');
+    file.read(content.data(), static_cast<std::streamsize>(size));
+    if (file.bad()) {
+        return std::nullopt;
+    }
+    content.resize(static_cast<size_t>(file.gcount()));
+    return content;
+}
+
+std::string Gzip(const std::string& content) {
+    namespace io = boost::iostreams;
+    std::string compressed;
+    {
+        io::filtering_ostream out;
+        out.push(io::gzip_compressor(io::gzip_params(io::gzip::best_compression)));
+        out.push(io::back_inserter(compressed));
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+    return compressed;
+}
+
+std::string FormatHttpDate(fs::file_time_type time) {
+    const auto sys_time = std::chrono::file_clock::to_sys(time);
+    const std::time_t seconds = std::chrono::system_clock::to_time_t(
+        std::chrono::time_point_cast<std::chrono::system_clock::duration>(sys_time));
+    // Индекс строится до запуска потоков, поэтому gmtime безопасен
+    char buffer[64];
+    std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", std::gmtime(&seconds));
+    return buffer;
+}
+
+}  // namespace
+
+std::string_view GetContentType(const std::string& extension) {
+    if (auto it = content_types.find(extension); it != content_types.end()) {
+        return it->second;
+    }
+    return ContentType::APPLICATION_OCTET_STREAM;
+}
+
+StaticFiles::StaticFiles(const fs::path& root, uintmax_t sendfile_threshold)
+    : sendfile_threshold_(sendfile_threshold) {
+    std::error_code ec;
+    const fs::path base = fs::canonical(root, ec);
+    if (ec) {
+        return;
+    }
+    for (auto it = fs::recursive_directory_iterator(base, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        // Символическая ссылка отдаётся, только если ведёт на файл внутри корня
+        std::error_code entry_ec;
+        const fs::path target = fs::canonical(it->path(), entry_ec);
+        if (entry_ec || !IsUnder(target, base) || !fs::is_regular_file(target, entry_ec)) {
+            continue;
+        }
+        AddFile("/" + it->path().lexically_relative(base).generic_string(), target);
+    }
+}
+
+void StaticFiles::AddFile(std::string url, const fs::path& path) {
+    // Файл, исчезнувший или ставший недоступным во время обхода, просто не попадает в индекс
+    std::error_code ec;
+    auto file = std::make_shared<File>();
+    file->path = path;
+    file->content_type = GetContentType(GetFileExtension(std::string_view{url}.substr(url.rfind('/') + 1)));
+    file->size = fs::file_size(path, ec);
+    if (ec) {
+        return;
+    }
+    const auto modified = fs::last_write_time(path, ec);
+    if (ec) {
+        return;
+    }
+    file->last_modified = FormatHttpDate(modified);
+
+    if (file->size <= sendfile_threshold_) {
+        auto read = ReadFile(path, file->size);
+        if (!read) {
+            return;
+        }
+        auto content = std::move(*read);
+        file->etag = MakeStrongETag(content);
+        if (IsCompressible(file->content_type)) {
+            auto compressed = Gzip(content);
+            if (compressed.size() < content.size()) {
+                // Сжатое представление — другие байты, поэтому и тег у него свой
+                file->gzip_etag = file->etag.substr(0, file->etag.size() - 1) + "-gz\"";
+                file->gzip_body = std::make_shared<const std::string>(std::move(compressed));
+            }
+        }
+        file->size = content.size();
+        file->body = std::make_shared<const std::string>(std::move(content));
+    } else {
+        // Большой файл не читаем целиком, тег строится по времени изменения и размеру
+        char etag[48];
+        const int size = std::snprintf(etag, sizeof(etag), "\"%llx-%llx\"",
+            static_cast<unsigned long long>(modified.time_since_epoch().count()), static_cast<unsigned long long>(file->size));
+        file->etag.assign(etag, static_cast<size_t>(size));
+    }
+
+    if (url.ends_with("/index.html")) {
+        std::string directory = url.substr(0, url.size() - std::string_view("index.html").size());
+        if (directory.size() > 1) {
+            files_.emplace(directory.substr(0, directory.size() - 1), file);
+        }
+        files_.emplace(std::move(directory), file);
+    }
+    files_.emplace(std::move(url), std::move(file));
+}
+
+const StaticFiles::File* StaticFiles::Find(std::string_view path) const {
+    auto it = files_.find(path);
+    return it == files_.end() ? nullptr : it->second.get();
+}
+
+}  // namespace http_handler
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http_handler {
+
+// Индекс www-root, собранный при старте. Файлы не больше sendfile_threshold лежат в памяти
+// вместе со сжатой заранее gzip-копией, большие отправляются с диска через sendfile.
+// Поиск по пути — одно обращение к хеш-таблице без системных вызовов
+class StaticFiles {
+public:
+    static constexpr uintmax_t DEFAULT_SENDFILE_THRESHOLD = 2 * 1024 * 1024;
+
+    struct File {
+        std::filesystem::path path;
+        std::string_view content_type;
+        uintmax_t size = 0;
+        std::string etag;
+        // Дата изменения в формате HTTP-date
+        std::string last_modified;
+        // nullptr, если файл слишком велик для кэша
+        std::shared_ptr<const std::string> body;
+        // nullptr, если файл не сжимается или не в кэше
+        std::shared_ptr<const std::string> gzip_body;
+        std::string gzip_etag;
+    };
+
+    explicit StaticFiles(const std::filesystem::path& root, uintmax_t sendfile_threshold = DEFAULT_SENDFILE_THRESHOLD);
+
+    // path — декодированный путь запроса, начинается с '/'. Каталог отдаёт свой index.html
+    const File* Find(std::string_view path) const;
+
+private:
+    struct PathHasher {
+        using is_transparent = void;
+        size_t operator()(std::string_view path) const noexcept { return std::hash<std::string_view>{}(path); }
+    };
+
+    // url — путь запроса к файлу, path — канонический путь на диске
+    void AddFile(std::string url, const std::filesystem::path& path);
+
+    uintmax_t sendfile_threshold_;
+    // Путь к каталогу и путь к его index.html указывают на один и тот же файл
+    std::unordered_map<std::string, std::shared_ptr<const File>, PathHasher, std::equal_to<>> files_;
+};
+
+std::string_view GetContentType(const std::string& extension);
+
+}  // namespace http_handler
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace util {
+
+// Арена для временных данных одного тика. Память раздаётся из буфера, который
+// живёт между тиками, и освобождается разом после тика. Если буфера не хватило,
+// недостающее берётся из кучи, а к следующему тику буфер увеличивается на столько же.
+// Поэтому в установившемся режиме тик с ареной не обращается к куче
+class TickArena {
+public:
+    static constexpr size_t DEFAULT_SIZE = 64 * 1024;
+
+    explicit TickArena(size_t initial_size = DEFAULT_SIZE)
+        : buffer_(initial_size) {
+    }
+
+    // Вызывает fn(std::pmr::memory_resource*). Всё, что выделено из ресурса,
+    // должно быть освобождено до выхода из fn
+    template <typename Fn>
+    void Run(Fn&& fn) {
+        size_t overflow = 0;
+        {
+            OverflowCounter upstream{overflow};
+            std::pmr::monotonic_buffer_resource resource{buffer_.data(), buffer_.size(), &upstream};
+            fn(static_cast<std::pmr::memory_resource*>(&resource));
+        }
+        if (overflow > 0) {
+            buffer_.resize(buffer_.size() + overflow);
+        }
+    }
+
+    size_t GetCapacity() const noexcept {
+        return buffer_.size();
+    }
+
+private:
+    // Пропускает выделения в кучу и считает, сколько байт не поместилось в буфер
+    class OverflowCounter : public std::pmr::memory_resource {
+    public:
+        explicit OverflowCounter(size_t& bytes) : bytes_(bytes) {}
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            bytes_ += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        size_t& bytes_;
+    };
+
+    std::vector<std::byte> buffer_;
+};
+
+}  // namespace util
@@ -2,7 +2,7 @@
 
 void Ticker::Start() {
     net::dispatch(strand_, [self = shared_from_this()] {
-        self->GetLastTick() = Clock::now();
+        self->GetLastTick() = self->clock_();
         self->ScheduleTick();
     });
 }
@@ -20,14 +20,21 @@ void Ticker::OnTick(sys::error_code ec) {
     assert(strand_.running_in_this_thread());
 
     if (!ec) {
-        auto this_tick = Clock::now();
+        auto this_tick = clock_();
         auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
         last_tick_ = this_tick;
         try {
-            handler_(delta);
+            handler_(delta, [self = shared_from_this()](std::exception_ptr error) {
+                net::dispatch(self->strand_, [self, error] {
+                    if (error) {
+                        std::cerr << "Problem with the tick" << std::endl;
+                    }
+                    self->ScheduleTick();
+                });
+            });
         } catch (...) {
             std::cerr << "Problem with the tick" << std::endl;
+            ScheduleTick();
         }
-        ScheduleTick();
     }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <boost/asio.hpp>          
 #include <functional>               
 #include <chrono>                   
+#include <exception>
 #include <memory>                   
 #include <cassert>     
 #include <iostream>  
@@ -10,16 +11,41 @@
 namespace net = boost::asio;
 namespace sys = boost::system;
 
+// Часы, которые при каждом опросе сдвигаются ровно на step. Тики с ними всегда
+// длятся step независимо от загрузки, и записанная нагрузка воспроизводится точно
+class FixedStepClock {
+public:
+    explicit FixedStepClock(std::chrono::milliseconds step)
+        : step_{step} {
+    }
+
+    std::chrono::steady_clock::time_point operator()() {
+        auto now = now_;
+        now_ += step_;
+        return now;
+    }
+
+private:
+    std::chrono::milliseconds step_;
+    std::chrono::steady_clock::time_point now_{};
+};
+
 class Ticker : public std::enable_shared_from_this<Ticker> {
     public:
         using Strand = net::strand<net::io_context::executor_type>;
-        using Handler = std::function<void(std::chrono::milliseconds delta)>;
+        // Обработчик сообщает о завершении тика вызовом done, следующий тик планируется только после этого
+        using Done = std::function<void(std::exception_ptr error)>;
+        using Handler = std::function<void(std::chrono::milliseconds delta, Done done)>;
+        // Источник времени, по которому считается delta тика
+        using TickClock = std::function<std::chrono::steady_clock::time_point()>;
     
         // Функция handler будет вызываться внутри strand с интервалом period
-        Ticker(Strand strand, std::chrono::milliseconds period, Handler handler)
+        Ticker(Strand strand, std::chrono::milliseconds period, Handler handler,
+               TickClock clock = [] { return std::chrono::steady_clock::now(); })
             : strand_{strand}
             , period_{period}
-            , handler_{std::move(handler)} {
+            , handler_{std::move(handler)}
+            , clock_{std::move(clock)} {
         }
     
         void Start();
@@ -33,11 +59,10 @@ class Ticker : public std::enable_shared_from_this<Ticker> {
     
         void OnTick(sys::error_code ec);
     
-        using Clock = std::chrono::steady_clock;
-    
         Strand strand_;
         std::chrono::milliseconds period_;
         net::steady_timer timer_{strand_};
         Handler handler_;
+        TickClock clock_;
         std::chrono::steady_clock::time_point last_tick_;
     };
\ No newline at end of file
@@ -173,6 +173,7 @@ class GameState {
       self.playersLoaded = true;
       self._startGame();
     });
+    this._subscribeState();
   }
 
   tick() {
@@ -183,7 +184,9 @@ class GameState {
     if (!this.started)
       return false;
 
-    if ((this.ticks % this.posUpdateInterval == 0 || this.requestInstantUpdate) && !this.updateInProgress) {
+    // While the WebSocket is open the server pushes the state after every tick
+    if (this.stateSocket === undefined &&
+        (this.ticks % this.posUpdateInterval == 0 || this.requestInstantUpdate) && !this.updateInProgress) {
       this.requestInstantUpdate = false;
       this._updateState(function() {
         self._applyDesiredState();
@@ -424,6 +427,29 @@ class GameState {
     })
   }
 
+  _subscribeState() {
+    if (window.WebSocket === undefined)
+      return;
+
+    let self = this;
+    // Browsers cannot set headers on a WebSocket, so the token goes into the query
+    const scheme = location.protocol == 'https:' ? 'wss://' : 'ws://';
+    const socket = new WebSocket(scheme + location.host + '/api/v1/game/state/ws?token=' + Cookies.get('authToken'));
+    socket.onopen = function() {
+      self.stateSocket = socket;
+    };
+    socket.onmessage = function(event) {
+      self.desiredState = JSON.parse(event.data);
+      self.stateTime = performance.now();
+      if (self.started)
+        self._applyDesiredState();
+    };
+    // Fall back to polling
+    socket.onclose = function() {
+      self.stateSocket = undefined;
+    };
+  }
+
   _interpolateRotation(old_pos, new_pos) {
     const pi = Math.PI;
     const rot_speed = pi / 300;
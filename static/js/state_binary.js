@@ -0,0 +1,93 @@
+// Decoder for the binary bodies of /api/v1/game/state and /api/v1/game/players.
+// The server sends them instead of JSON when the request carries
+// "Accept: application/x-game-binary". Decoded objects have the same shape as the JSON.
+//
+// All numbers are little-endian. Coordinates and speeds are int32 in hundredths.
+//
+// State:
+//   header, 28 bytes:   "DGST", version u16, reserved u16, tick u64,
+//                       player count u32, loot count u32, bag item count u32
+//   player, 28 bytes:   id u32, x i32, y i32, dx i32, dy i32, score i32,
+//                       bag item count u16, dir u8 (0 U, 1 D, 2 L, 3 R), reserved u8
+//   bag item, 8 bytes:  id u32, type u32 -- items of all bags in player order
+//   loot, 16 bytes:     id u32, type u32, x i32, y i32
+//
+// Players:
+//   header, 12 bytes:   "DGPL", version u16, reserved u16, player count u32
+//   player, 8 bytes:    id u32, name length in bytes u32
+//   names:              UTF-8 names of all players, back to back
+
+const GAME_BINARY_TYPE = 'application/x-game-binary';
+const GAME_BINARY_VERSION = 1;
+const GAME_BINARY_SCALE = 100;
+const GAME_BINARY_DIRS = ['U', 'D', 'L', 'R'];
+
+function _checkGameBinaryHeader(view, magic) {
+  for (let i = 0; i < magic.length; i++) {
+    if (view.getUint8(i) != magic.charCodeAt(i))
+      throw new Error('Unexpected binary payload');
+  }
+  if (view.getUint16(4, true) != GAME_BINARY_VERSION)
+    throw new Error('Unsupported binary version');
+}
+
+// buffer is an ArrayBuffer, e.g. from fetch(...).then(r => r.arrayBuffer())
+function decodeGameState(buffer) {
+  const view = new DataView(buffer);
+  _checkGameBinaryHeader(view, 'DGST');
+
+  const tick = Number(view.getBigUint64(8, true));
+  const playerCount = view.getUint32(16, true);
+  const lootCount = view.getUint32(20, true);
+  const bagItemCount = view.getUint32(24, true);
+
+  let playerOffset = 28;
+  let bagOffset = playerOffset + playerCount * 28;
+  let lootOffset = bagOffset + bagItemCount * 8;
+
+  const players = {};
+  for (let i = 0; i < playerCount; i++, playerOffset += 28) {
+    const bag = [];
+    const bagSize = view.getUint16(playerOffset + 24, true);
+    for (let j = 0; j < bagSize; j++, bagOffset += 8) {
+      bag.push({id: view.getUint32(bagOffset, true), type: view.getUint32(bagOffset + 4, true)});
+    }
+    players[view.getUint32(playerOffset, true)] = {
+      pos: [view.getInt32(playerOffset + 4, true) / GAME_BINARY_SCALE, view.getInt32(playerOffset + 8, true) / GAME_BINARY_SCALE],
+      speed: [view.getInt32(playerOffset + 12, true) / GAME_BINARY_SCALE, view.getInt32(playerOffset + 16, true) / GAME_BINARY_SCALE],
+      dir: GAME_BINARY_DIRS[view.getUint8(playerOffset + 26)],
+      bag: bag,
+      score: view.getInt32(playerOffset + 20, true)
+    };
+  }
+
+  const lostObjects = {};
+  for (let i = 0; i < lootCount; i++, lootOffset += 16) {
+    lostObjects[view.getUint32(lootOffset, true)] = {
+      type: view.getUint32(lootOffset + 4, true),
+      pos: [view.getInt32(lootOffset + 8, true) / GAME_BINARY_SCALE, view.getInt32(lootOffset + 12, true) / GAME_BINARY_SCALE]
+    };
+  }
+
+  return {players: players, lostObjects: lostObjects, tick: tick};
+}
+
+function decodeGamePlayers(buffer) {
+  const view = new DataView(buffer);
+  _checkGameBinaryHeader(view, 'DGPL');
+
+  const count = view.getUint32(8, true);
+  const decoder = new TextDecoder();
+  let recordOffset = 12;
+  let nameOffset = recordOffset + count * 8;
+
+  const players = {};
+  for (let i = 0; i < count; i++, recordOffset += 8) {
+    const length = view.getUint32(recordOffset + 4, true);
+    players[view.getUint32(recordOffset, true)] = {
+      name: decoder.decode(new Uint8Array(buffer, nameOffset, length))
+    };
+    nameOffset += length;
+  }
+  return players;
+}
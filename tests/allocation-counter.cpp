@@ -0,0 +1,98 @@
+#include "allocation-counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local size_t allocation_count = 0;
+std::atomic<size_t> total_allocation_count{0};
+
+void* Allocate(size_t size, size_t alignment) {
+    ++allocation_count;
+    total_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+    void* p = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+        : std::malloc(size);
+    return p;
+}
+
+}  // namespace
+
+namespace test_hooks {
+
+size_t GetAllocationCount() noexcept {
+    return allocation_count;
+}
+
+size_t GetTotalAllocationCount() noexcept {
+    return total_allocation_count.load(std::memory_order_relaxed);
+}
+
+}  // namespace test_hooks
+
+void* operator new(size_t size) {
+    if (void* p = Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    if (void* p = Allocate(size, static_cast<size_t>(alignment))) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
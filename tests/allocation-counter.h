@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+namespace test_hooks {
+
+// Число вызовов глобального operator new в текущем потоке с начала работы.
+// Замена operator new находится в allocation-counter.cpp и действует во всём тестовом бинарнике
+size_t GetAllocationCount() noexcept;
+
+// Число вызовов глобального operator new во всех потоках процесса
+size_t GetTotalAllocationCount() noexcept;
+
+// Считает выделения в куче с момента создания: сделанные текущим потоком или всеми потоками процесса
+class AllocationCounter {
+public:
+    enum class Scope {
+        THREAD,
+        PROCESS
+    };
+
+    explicit AllocationCounter(Scope scope = Scope::THREAD) noexcept
+        : scope_(scope), start_(Read(scope)) {
+    }
+
+    size_t GetCount() const noexcept {
+        return Read(scope_) - start_;
+    }
+
+private:
+    static size_t Read(Scope scope) noexcept {
+        return scope == Scope::THREAD ? GetAllocationCount() : GetTotalAllocationCount();
+    }
+
+    Scope scope_;
+    size_t start_;
+};
+
+}  // namespace test_hooks
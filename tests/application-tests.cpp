@@ -0,0 +1,107 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/application.h"
+#include "../src/records.h"
+#include "allocation-counter.h"
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace model;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Квадрат из дорог 40x40 с офисом посередине нижней стороны
+Map MakeRingMap(const std::string& id) {
+    Map map(Map::Id{id}, "Ring " + id, 2);
+    map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 40});
+    map.AddRoad(Road{Road::VERTICAL, Point{40, 0}, 40});
+    map.AddRoad(Road{Road::HORIZONTAL, Point{40, 40}, 0});
+    map.AddRoad(Road{Road::VERTICAL, Point{0, 40}, 0});
+    map.AddOffice(Office{Office::Id{"office"}, Point{20, 0}, Offset{5, 0}});
+    return map;
+}
+
+}  // namespace
+
+TEST_CASE("Steady-state Application::Tick does not touch the heap", "[Tick]") {
+    Game game{false, std::make_shared<loot_gen::LootGenerator>(500ms, 1.0)};
+    game.AddDefaultDogSpeed(4.0);
+    game.AddDefaultBagCapacity(3);
+    game.SetMaxDogsPerSession(4);
+    game.SetRandomSeed(7);
+
+    ExtraData ex_data;
+    for (const std::string id : {"map1", "map2"}) {
+        game.AddMap(MakeRingMap(id));
+        for (int type = 0; type < 2; ++type) {
+            boost::json::object loot;
+            loot["value"] = 5 * (type + 1);
+            ex_data.SetLootsInMap(id, std::move(loot));
+        }
+    }
+
+    InMemoryRecords records;
+    app::Application app(game, ex_data, records, 1e9);
+    // Пул объявлен после приложения и останавливается раньше, чем исчезнет состояние ParallelFor
+    boost::asio::thread_pool pool(4);
+    app.SetTickExecutor({pool.get_executor(), 4});
+
+    auto join = app.GetJoinGameScenario();
+    std::vector<players::Token> tokens;
+    for (int i = 0; i < 16; ++i) {
+        auto result = join->Execute("Dog" + std::to_string(i), i % 2 == 0 ? "map1" : "map2");
+        REQUIRE(result);
+        tokens.push_back(result->token);
+    }
+    size_t sessions = 0;
+    for (const auto& [id, instances] : game.GetSessions()) {
+        sessions += instances.size();
+    }
+    REQUIRE(sessions == 4);
+
+    {
+        test_hooks::AllocationCounter probe{test_hooks::AllocationCounter::Scope::PROCESS};
+        auto value = std::make_unique<int>(1);
+        REQUIRE(probe.GetCount() == 1);
+    }
+
+    // Между тиками собаки поворачивают в углах, как по командам игроков: чётные обходят кольцо против
+    // часовой стрелки, нечётные по ней, подбирают трофеи и сдают их в офис.
+    // Команды в замер не входят, считаются выделения всех потоков за время тика
+    static constexpr Direction ROUTES[2][4] = {
+        {Direction::EAST, Direction::NORTH, Direction::WEST, Direction::SOUTH},
+        {Direction::NORTH, Direction::EAST, Direction::SOUTH, Direction::WEST}};
+    auto action = app.GetActionGameScenario();
+    size_t allocations = 0;
+    for (int tick = 0; tick < 1200; ++tick) {
+        // Сторона кольца проходится за 100 тиков
+        if (tick % 100 == 0) {
+            for (size_t i = 0; i < tokens.size(); ++i) {
+                action->Execute(tokens[i], ROUTES[i % 2][tick / 100 % 4]);
+            }
+        }
+
+        test_hooks::AllocationCounter counter{test_hooks::AllocationCounter::Scope::PROCESS};
+        app.Tick(100ms);
+        // Первые тики растят арены, ёмкости контейнеров и память задач пула
+        if (tick >= 400) {
+            allocations += counter.GetCount();
+        }
+    }
+    CHECK(allocations == 0);
+
+    int score = 0;
+    for (const auto& [id, instances] : game.GetSessions()) {
+        for (const auto& session : instances) {
+            for (const auto& dog_score : session->GetDogs().GetPoints()) {
+                score += dog_score;
+            }
+        }
+    }
+    CHECK(score > 0);
+}
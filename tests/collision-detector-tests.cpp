@@ -233,4 +233,143 @@ TEST_CASE("Items are collected in correct order", "[FindGatherEvents]") {
     CHECK(events[1].item_id == 0);
     CHECK(events[2].item_id == 2);
 }
-    
\ No newline at end of file
+
+TEST_CASE("Broad phase keeps events of a crowded field", "[FindGatherEvents]") {
+    std::vector<collision_detector::Item> items;
+    for (int i = 0; i < 100; ++i) {
+        items.push_back({{static_cast<double>(i), 0.0}, 0.0, i});
+        items.push_back({{static_cast<double>(i), 5.0}, 0.0, 100 + i});
+    }
+    std::vector<collision_detector::Gatherer> gatherers{
+        {{10.5, 0}, {20.5, 0}, 0.6, 0},
+        {{50, 5}, {50, -5}, 0.3, 1}
+    };
+
+    TestProvider provider(items, gatherers);
+    auto events = collision_detector::FindGatherEvents(provider);
+
+    std::vector<std::pair<size_t, size_t>> collected;
+    for (const auto& event : events) {
+        collected.emplace_back(event.gatherer_id, event.item_id);
+    }
+    std::sort(collected.begin(), collected.end());
+
+    std::vector<std::pair<size_t, size_t>> expected;
+    for (size_t i = 11; i <= 20; ++i) {
+        expected.emplace_back(0, i);
+    }
+    expected.emplace_back(1, 50);
+    expected.emplace_back(1, 150);
+    CHECK(collected == expected);
+
+    for (size_t i = 1; i < events.size(); ++i) {
+        CHECK(events[i - 1].time <= events[i].time);
+    }
+}
+
+TEST_CASE("Grid matches brute force for gatherers outside the items", "[FindGatherEvents]") {
+    // Сетка строится при 16 и более предметах
+    std::vector<collision_detector::Item> items;
+    for (int i = 0; i < 25; ++i) {
+        items.push_back({{static_cast<double>(i % 5) * 2.5, static_cast<double>(i / 5) * 2.5}, 0.1, i});
+    }
+    const std::vector<collision_detector::Gatherer> gatherers{
+        {{-1e6, -1e6}, {1e6, 1e6}, 0.5, 0},
+        {{-1e3, 5.0}, {1e3, 5.0}, 0.5, 1},
+        {{-50, -50}, {-40, -40}, 0.5, 2},
+        {{1e30, -1e30}, {1e30, 1e30}, 1e31, 3},
+        {{5.0, -1e22}, {5.0, -1e21}, 1e23, 4},
+        {{100, 100}, {200, 100}, 1e40, 5},
+        {{1e25, 1e25}, {2e25, -1e25}, 0.5, 6}
+    };
+
+    std::vector<std::pair<size_t, size_t>> expected;
+    for (size_t g = 0; g < gatherers.size(); ++g) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            const auto result = collision_detector::TryCollectPoint(gatherers[g].start_pos, gatherers[g].end_pos,
+                                                                    items[i].position);
+            if (result.IsCollected(gatherers[g].width + items[i].width)) {
+                expected.emplace_back(g, i);
+            }
+        }
+    }
+    REQUIRE_FALSE(expected.empty());
+
+    TestProvider provider(items, gatherers);
+    std::vector<std::pair<size_t, size_t>> collected;
+    for (const auto& event : collision_detector::FindGatherEvents(provider)) {
+        collected.emplace_back(event.gatherer_id, event.item_id);
+    }
+    std::sort(collected.begin(), collected.end());
+    CHECK(collected == expected);
+}
+
+TEST_CASE("Batch kernels match TryCollectPoint", "[CollectPointsBatch]") {
+    using collision_detector::BatchKernel;
+
+    std::vector<double> xs, ys, widths;
+    for (int i = 0; i < 37; ++i) {
+        xs.push_back(std::fmod(i * 0.731, 6.0) - 0.5);
+        ys.push_back(std::fmod(i * 0.377, 2.0) - 1.0);
+        widths.push_back(i % 3 == 0 ? 0.0 : 0.25);
+    }
+    const geom::Point2D a{0.0, 0.1};
+    const geom::Point2D b{5.0, -0.2};
+    const double gatherer_width = 0.3;
+
+    std::vector<collision_detector::BatchHit> expected;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        auto result = collision_detector::TryCollectPoint(a, b, {xs[i], ys[i]});
+        if (result.IsCollected(gatherer_width + widths[i])) {
+            expected.push_back({i + 100, result.sq_distance, result.proj_ratio});
+        }
+    }
+    REQUIRE(!expected.empty());
+
+    const auto best = collision_detector::GetBestBatchKernel();
+    for (auto kernel : {BatchKernel::SCALAR, BatchKernel::SSE2, BatchKernel::AVX2}) {
+        if (kernel > best) {
+            continue;
+        }
+        INFO("kernel: " << static_cast<int>(kernel));
+        std::pmr::vector<collision_detector::BatchHit> hits;
+        collision_detector::CollectPointsBatch(kernel, a, b, gatherer_width, xs.data(), ys.data(), widths.data(),
+                                               xs.size(), 100, hits);
+        REQUIRE(hits.size() == expected.size());
+        for (size_t i = 0; i < hits.size(); ++i) {
+            CHECK(hits[i].index == expected[i].index);
+            CHECK(hits[i].sq_distance == expected[i].sq_distance);
+            CHECK(hits[i].proj_ratio == expected[i].proj_ratio);
+        }
+    }
+}
+
+struct SpanProvider {
+    std::vector<collision_detector::Item> items;
+    std::vector<collision_detector::Gatherer> gatherers;
+
+    std::span<const collision_detector::Item> GetItems() const { return items; }
+    std::span<const collision_detector::Gatherer> GetGatherers() const { return gatherers; }
+};
+
+static_assert(collision_detector::ItemGathererSpans<SpanProvider>);
+static_assert(!collision_detector::ItemGathererSpans<TestProvider>);
+
+TEST_CASE("Span provider gives the same events as the virtual one", "[FindGatherEvents]") {
+    SpanProvider spans{
+        {{{3, 0}, 0.5, 0}, {{1, 0}, 0.5, 1}, {{5, 5}, 0.5, 2}, {{5, 0.2}, 0.0, 3}},
+        {{{0, 0}, {10, 0}, 1.0, 0}, {{0, 0}, {10, 10}, 1.0, 1}, {{2, 2}, {2, 2}, 1.0, 2}}
+    };
+    TestProvider provider(spans.items, spans.gatherers);
+
+    auto expected = collision_detector::FindGatherEvents(provider);
+    auto events = collision_detector::FindGatherEvents(spans);
+
+    REQUIRE(events.size() == expected.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        CHECK(events[i].item_id == expected[i].item_id);
+        CHECK(events[i].gatherer_id == expected[i].gatherer_id);
+        CHECK(events[i].time == expected[i].time);
+        CHECK(events[i].sq_distance == expected[i].sq_distance);
+    }
+}
@@ -0,0 +1,70 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/http_cache.h"
+
+using namespace http_handler;
+
+TEST_CASE("Strong ETag depends only on the body", "[HttpCache]") {
+    const auto etag = MakeStrongETag("{\"id\":\"map1\"}");
+    CHECK(etag.front() == '"');
+    CHECK(etag.back() == '"');
+    CHECK(etag == MakeStrongETag("{\"id\":\"map1\"}"));
+    CHECK(etag != MakeStrongETag("{\"id\":\"map2\"}"));
+
+    const auto cached = MakeCachedBody("{}");
+    CHECK(*cached.body == "{}");
+    CHECK(cached.etag == MakeStrongETag("{}"));
+}
+
+TEST_CASE("If-None-Match matches any listed tag", "[HttpCache]") {
+    const std::string etag = "\"abc\"";
+    CHECK(MatchesIfNoneMatch("\"abc\"", etag));
+    CHECK(MatchesIfNoneMatch("\"x\", \"abc\"", etag));
+    CHECK(MatchesIfNoneMatch("W/\"abc\"", etag));
+    CHECK(MatchesIfNoneMatch("*", etag));
+    CHECK_FALSE(MatchesIfNoneMatch("", etag));
+    CHECK_FALSE(MatchesIfNoneMatch("\"abcd\"", etag));
+    CHECK_FALSE(MatchesIfNoneMatch("abc", etag));
+}
+
+TEST_CASE("Range selects a single byte range", "[HttpCache]") {
+    using Kind = RangeRequest::Kind;
+
+    auto range = ParseRange("bytes=0-99", 1000);
+    CHECK(range.kind == Kind::PARTIAL);
+    CHECK(range.offset == 0);
+    CHECK(range.length == 100);
+
+    range = ParseRange("bytes=900-", 1000);
+    CHECK(range.kind == Kind::PARTIAL);
+    CHECK(range.offset == 900);
+    CHECK(range.length == 100);
+
+    range = ParseRange("bytes=-10", 1000);
+    CHECK(range.kind == Kind::PARTIAL);
+    CHECK(range.offset == 990);
+    CHECK(range.length == 10);
+
+    range = ParseRange("bytes=500-5000", 1000);
+    CHECK(range.kind == Kind::PARTIAL);
+    CHECK(range.length == 500);
+
+    CHECK(ParseRange("bytes=-5000", 1000).length == 1000);
+    CHECK(ParseRange("bytes=1000-", 1000).kind == Kind::UNSATISFIABLE);
+    CHECK(ParseRange("bytes=-0", 1000).kind == Kind::UNSATISFIABLE);
+    CHECK(ParseRange("", 1000).kind == Kind::FULL);
+    CHECK(ParseRange("bytes=0-1,5-6", 1000).kind == Kind::FULL);
+    CHECK(ParseRange("bytes=9-1", 1000).kind == Kind::FULL);
+    CHECK(ParseRange("items=0-1", 1000).kind == Kind::FULL);
+    CHECK(ParseRange("bytes=x-1", 1000).kind == Kind::FULL);
+}
+
+TEST_CASE("Accept-Encoding honours zero weights", "[HttpCache]") {
+    CHECK(AcceptsEncoding("gzip, deflate, br", "gzip"));
+    CHECK(AcceptsEncoding("br;q=1.0, gzip;q=0.5", "gzip"));
+    CHECK(AcceptsEncoding("*", "gzip"));
+    CHECK_FALSE(AcceptsEncoding("gzip;q=0", "gzip"));
+    CHECK_FALSE(AcceptsEncoding("gzip; q=0.0", "gzip"));
+    CHECK_FALSE(AcceptsEncoding("deflate, br", "gzip"));
+    CHECK_FALSE(AcceptsEncoding("", "gzip"));
+}
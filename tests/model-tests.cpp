@@ -2,6 +2,7 @@
 
 #include "../src/model.h"
 #include <memory>
+#include <algorithm>
 
 using namespace model;
 using namespace std::chrono_literals;
@@ -62,3 +63,342 @@ class MockLootGenerator : public loot_gen::LootGenerator {
         }
     }
 
+
+    TEST_CASE("Map::IsOnRoad uses road index", "[Roads]") {
+        Map map(Map::Id{"map1"}, "TestMap", 1);
+        map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 10});
+        map.AddRoad(Road{Road::HORIZONTAL, Point{20, 0}, 10});  // продолжает первую дорогу в обратную сторону
+        map.AddRoad(Road{Road::HORIZONTAL, Point{30, 0}, 40});
+        map.AddRoad(Road{Road::VERTICAL, Point{10, 0}, 10});
+
+        SECTION("Points on and near roads") {
+            CHECK(map.IsOnRoad({0.0, 0.0}));
+            CHECK(map.IsOnRoad({15.0, 0.4}));
+            CHECK(map.IsOnRoad({-0.4, -0.4}));
+            CHECK(map.IsOnRoad({20.4, 0.0}));
+            CHECK(map.IsOnRoad({10.3, 7.5}));
+            CHECK(map.IsOnRoad({9.7, 10.3}));
+        }
+
+        SECTION("Points off roads") {
+            CHECK_FALSE(map.IsOnRoad({5.0, 0.41}));
+            CHECK_FALSE(map.IsOnRoad({-0.41, 0.0}));
+            CHECK_FALSE(map.IsOnRoad({25.0, 0.0}));
+            CHECK_FALSE(map.IsOnRoad({10.5, 5.0}));
+            CHECK_FALSE(map.IsOnRoad({10.0, 10.5}));
+            CHECK_FALSE(map.IsOnRoad({5.0, 5.0}));
+        }
+    }
+
+    TEST_CASE("Map::MoveAlongRoads stops at the road edge", "[Roads]") {
+        Map map(Map::Id{"map1"}, "TestMap", 1);
+        map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 10});
+        map.AddRoad(Road{Road::VERTICAL, Point{10, 0}, 10});
+
+        SECTION("Free movement inside a road") {
+            auto pos = map.MoveAlongRoads({1.0, 0.0}, {4.5, 0.0});
+            CHECK(pos.x == 4.5);
+            CHECK(pos.y == 0.0);
+        }
+
+        SECTION("Movement is clamped at the end of a road") {
+            auto pos = map.MoveAlongRoads({1.0, 0.2}, {-5.0, 0.2});
+            CHECK(pos.x == 0.0 - 0.4);
+            CHECK(pos.y == 0.2);
+        }
+
+        SECTION("Crossing allows turning onto another road") {
+            auto pos = map.MoveAlongRoads({10.0, 0.3}, {10.0, 25.0});
+            CHECK(pos.x == 10.0);
+            CHECK(pos.y == 10.0 + 0.4);
+
+            auto back = map.MoveAlongRoads({10.3, 0.0}, {30.0, 0.0});
+            CHECK(back.x == 10.0 + 0.4);
+        }
+
+        SECTION("Stopped point on the edge stays on the road") {
+            auto pos = map.MoveAlongRoads({5.0, 0.0}, {5.0, 3.0});
+            CHECK(pos.y == 0.4);
+            CHECK(map.IsOnRoad(pos));
+            CHECK(map.MoveAlongRoads(pos, {5.0, 3.0}).y == 0.4);
+        }
+    }
+
+    TEST_CASE("Map::GetPositionAtRoadDistance walks roads by length", "[Roads]") {
+        Map map(Map::Id{"map1"}, "TestMap", 1);
+        map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 10});
+        map.AddRoad(Road{Road::VERTICAL, Point{5, 5}, 5});     // точка, длина 0
+        map.AddRoad(Road{Road::VERTICAL, Point{20, 30}, 0});   // идёт вниз по y
+        REQUIRE(map.GetTotalRoadLength() == 40.0);
+
+        auto first = map.GetPositionAtRoadDistance(4.0);
+        CHECK(first.x == 4.0);
+        CHECK(first.y == 0.0);
+
+        auto second = map.GetPositionAtRoadDistance(15.0);
+        CHECK(second.x == 20.0);
+        CHECK(second.y == 25.0);
+
+        auto end = map.GetPositionAtRoadDistance(40.0);
+        CHECK(end.x == 20.0);
+        CHECK(end.y == 0.0);
+    }
+
+    TEST_CASE("Xoshiro256 is reproducible and stays in range", "[Random]") {
+        util::Xoshiro256 a{42};
+        util::Xoshiro256 b{42};
+        util::Xoshiro256 c{43};
+        bool differs = false;
+        for (int i = 0; i < 1000; ++i) {
+            auto value = a();
+            REQUIRE(value == b());
+            differs = differs || value != c();
+
+            auto below = a.NextBelow(7);
+            b.NextBelow(7);
+            CHECK(below < 7);
+
+            auto unit = a.NextDouble();
+            b.NextDouble();
+            CHECK(unit >= 0.0);
+            CHECK(unit < 1.0);
+        }
+        CHECK(differs);
+    }
+
+    TEST_CASE("RoadGraph joins roads at ends and crossings", "[Roads]") {
+        Map map(Map::Id{"map1"}, "TestMap", 1);
+        map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 10});
+        map.AddRoad(Road{Road::VERTICAL, Point{10, 0}, 10});
+        map.AddRoad(Road{Road::VERTICAL, Point{5, -5}, 5});
+        map.BuildRoadGraph();
+
+        const auto& graph = map.GetRoadGraph();
+        // (0,0) (10,0) (10,10) (5,-5) (5,0) (5,5)
+        REQUIRE(graph.GetNodeCount() == 6);
+        // Первая дорога разбита перекрёстком на два участка
+        REQUIRE(graph.GetEdgeCount() == 5);
+
+        auto crossing = graph.FindNode({5, 0});
+        REQUIRE(crossing);
+        CHECK(graph.GetNodeEdges(*crossing).size() == 4);
+        CHECK(graph.GetRoadsAt({5, 0}) == std::vector<size_t>{0, 2});
+        CHECK(graph.GetRoadsAt({10, 0}) == std::vector<size_t>{0, 1});
+        CHECK(graph.GetRoadsAt({10, 10}) == std::vector<size_t>{1});
+        CHECK_FALSE(graph.FindNode({3, 0}));
+
+        for (size_t edge = 0; edge < graph.GetEdgeCount(); ++edge) {
+            const auto& e = graph.GetEdge(edge);
+            for (auto node : {e.from, e.to}) {
+                auto edges = graph.GetNodeEdges(node);
+                CHECK(std::find(edges.begin(), edges.end(), edge) != edges.end());
+            }
+        }
+    }
+
+    TEST_CASE("DogStore keeps handles valid after removal", "[Dogs]") {
+        DogStore store;
+        store.Add(Dog("Rex", 0, 3, {1.0, 0.0}));
+        store.Add(Dog("Bim", 1, 3, {2.0, 0.0}));
+        store.Add(Dog("Sharik", 2, 3, {3.0, 0.0}));
+        store.GetPoints()[*store.Find(DogHandle{2})] = 7;
+
+        store.Remove(DogHandle{0});
+
+        REQUIRE(store.Size() == 2);
+        CHECK_FALSE(store.Find(DogHandle{0}));
+
+        auto sharik = store.Find(DogHandle{2});
+        REQUIRE(sharik);
+        CHECK(store.GetNames()[*sharik] == "Sharik");
+        CHECK(store.GetPositions()[*sharik].x == 3.0);
+        CHECK(store.GetPoints()[*sharik] == 7);
+
+        auto bim = store.Find(DogHandle{1});
+        REQUIRE(bim);
+        DogRef dog(store, *bim);
+        dog.SetPosition({5.0, 0.0});
+        CHECK(store.Get(*bim).GetPosition().x == 5.0);
+        CHECK(store.Get(*bim).GetName() == "Bim");
+    }
+
+    TEST_CASE("SlotMap detects stale keys", "[Loots]") {
+        util::SlotMap<Loot> loots;
+        auto first = loots.Insert(Loot(0, {1.0, 0.0}, 10));
+        auto second = loots.Insert(Loot(1, {2.0, 0.0}, 11));
+        auto third = loots.Insert(Loot(0, {3.0, 0.0}, 12));
+
+        REQUIRE(loots.Remove(first));
+        CHECK_FALSE(loots.Remove(first));
+        CHECK_FALSE(loots.Find(first));
+        REQUIRE(loots.Size() == 2);
+        CHECK(loots.Find(second)->GetId() == 11);
+        CHECK(loots.Find(third)->GetId() == 12);
+
+        // Освободившийся слот переиспользуется с новым поколением
+        auto fourth = loots.Insert(Loot(1, {4.0, 0.0}, 13));
+        CHECK(fourth.index == first.index);
+        CHECK(fourth != first);
+        CHECK_FALSE(loots.Find(first));
+        CHECK(loots.Find(fourth)->GetId() == 13);
+
+        for (size_t i = 0; i < loots.Size(); ++i) {
+            CHECK(loots.Find(loots.GetKeys()[i]) == &loots.GetValues()[i]);
+        }
+    }
+
+    TEST_CASE("Bag keeps items inline and overflows above the bound", "[Bag]") {
+        Bag small(3);
+        small.AddItem(7, 1);
+        small.AddItem(8, 2);
+        small.AddItem(9, 0);
+        CHECK(small.IsFull());
+        CHECK_THROWS_AS(small.AddItem(10, 1), std::length_error);
+        REQUIRE(small.GetItems().size() == 3);
+        CHECK(small.GetItems()[1].id == 8);
+        CHECK(small.GetItems()[1].type == 2);
+
+        small.Clear();
+        CHECK(small.GetItems().empty());
+        CHECK_FALSE(small.IsFull());
+
+        const int big_capacity = static_cast<int>(Bag::INLINE_CAPACITY) + 2;
+        Bag big(big_capacity);
+        for (int i = 0; i < big_capacity; ++i) {
+            big.AddItem(i, i % 3);
+        }
+        CHECK(big.IsFull());
+        Bag copy = big;
+        REQUIRE(copy.GetItems().size() == static_cast<size_t>(big_capacity));
+        CHECK(copy.GetItems().back().id == big_capacity - 1);
+    }
+
+    TEST_CASE("Game opens a new session instance when all are full", "[Sessions]") {
+        Game game{false, std::make_shared<MockLootGenerator>()};
+        game.SetMaxDogsPerSession(2);
+
+        Map map(Map::Id{"map1"}, "TestMap", 1);
+        map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 10});
+        game.AddMap(map);
+
+        auto first = game.GetSession(Map::Id{"map1"});
+        first->AddDog("Bim", 3);
+        CHECK(game.GetSession(Map::Id{"map1"}) == first);
+        first->AddDog("Bom", 3);
+
+        auto second = game.GetSession(Map::Id{"map1"});
+        REQUIRE(second != first);
+        CHECK(second->GetInstance() == 1);
+        CHECK(second->GetMap() == first->GetMap());
+        CHECK(game.FindSession(Map::Id{"map1"}, 1) == second);
+        CHECK_FALSE(game.FindSession(Map::Id{"map1"}, 2));
+
+        // Освободилось место — новичок попадает в наименее загруженный экземпляр
+        second->AddDog("Rex", 3);
+        first->RemoveDog(DogHandle{0});
+        first->RemoveDog(DogHandle{1});
+        CHECK(game.GetSession(Map::Id{"map1"}) == first);
+        CHECK_FALSE(game.GetSession(Map::Id{"unknown"}));
+    }
+
+    TEST_CASE("GameSession state version changes with the session", "[Sessions]") {
+        Game game{false, std::make_shared<MockLootGenerator>()};
+        Map map(Map::Id{"map1"}, "TestMap", 2);
+        map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 10});
+        game.AddMap(map);
+        auto session = game.GetSession(Map::Id{"map1"});
+
+        auto version = session->GetStateVersion();
+        const auto dog = session->AddDog("Bim", 3);
+        CHECK(session->GetStateVersion() != version);
+
+        version = session->GetStateVersion();
+        session->AddLoots(0);
+        CHECK(session->GetStateVersion() == version);
+        session->AddLoots(1);
+        CHECK(session->GetStateVersion() != version);
+
+        version = session->GetStateVersion();
+        session->RemoveDog(dog);
+        CHECK(session->GetStateVersion() != version);
+    }
+
+    TEST_CASE("GameSession tracks changes for delta state", "[Sessions]") {
+        Game game{false, std::make_shared<MockLootGenerator>()};
+        Map map(Map::Id{"map1"}, "TestMap", 2);
+        map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 10});
+        game.AddMap(map);
+        auto session = game.GetSession(Map::Id{"map1"});
+
+        const auto bim = session->AddDog("Bim", 3);
+        const auto bom = session->AddDog("Bom", 3);
+        session->AddLoots(1);
+        session->FinishTick();
+        REQUIRE(session->GetTick() == 1);
+        CHECK(session->GetDogs().GetChangeTicks()[0] == 1);
+        CHECK(session->GetLoots().GetValues()[0].GetAddedTick() == 1);
+
+        // После тика 1 меняется только Bom и пропадает трофей
+        session->GetDog(bom)->SetVelocity({1.0, 0.0});
+        session->RemoveLoot(session->GetLoots().GetKeys()[0]);
+        session->FinishTick();
+        CHECK(session->GetDogs().GetChangeTicks()[*session->GetDogs().Find(bim)] == 1);
+        CHECK(session->GetDogs().GetChangeTicks()[*session->GetDogs().Find(bom)] == 2);
+        REQUIRE(session->GetRemovedLoots().size() == 1);
+        CHECK(session->GetRemovedLoots()[0].tick == 2);
+
+        session->RemoveDog(bim);
+        REQUIRE(session->GetRemovedDogs().size() == 1);
+        CHECK(session->GetRemovedDogs()[0].tick == 3);
+        CHECK(session->GetRemovedDogs()[0].id == bim.id);
+
+        const uint64_t epoch = GameSession::GetEpoch();
+        CHECK(epoch < (uint64_t{1} << 53));
+        CHECK(session->CanDeltaSince(epoch, 0));
+        CHECK_FALSE(session->CanDeltaSince(epoch, 3));
+        // Номер тика из другой эпохи, например полученный до перезапуска, не годится
+        CHECK_FALSE(session->CanDeltaSince(epoch + 1, 2));
+        for (uint64_t i = 0; i < GameSession::DELTA_HISTORY_TICKS; ++i) {
+            session->FinishTick();
+        }
+        CHECK_FALSE(session->CanDeltaSince(epoch, 1));
+        CHECK(session->CanDeltaSince(epoch, 2));
+        // Удаление трофея после тика 2 уже не нужно никому, удаление собаки ещё нужно
+        CHECK(session->GetRemovedLoots().empty());
+        CHECK(session->GetRemovedDogs().size() == 1);
+    }
+
+    TEST_CASE("Game with a seed spawns reproducibly", "[Random]") {
+        auto spawn = [](uint64_t seed) {
+            Game game{true, std::make_shared<MockLootGenerator>()};
+            game.SetRandomSeed(seed);
+            Map map(Map::Id{"map1"}, "TestMap", 3);
+            map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 40});
+            map.AddRoad(Road{Road::VERTICAL, Point{40, 0}, 30});
+            game.AddMap(map);
+
+            auto session = game.GetSession(Map::Id{"map1"});
+            session->AddDog("Bim", 3);
+            session->AddLoots(5);
+
+            std::vector<std::pair<Position, int>> result;
+            result.emplace_back(session->GetDogs().Get(0).GetPosition(), -1);
+            for (const auto& loot : session->GetLoots().GetValues()) {
+                result.emplace_back(loot.GetPosition(), loot.GetType());
+            }
+            return result;
+        };
+
+        auto first = spawn(7);
+        auto second = spawn(7);
+        auto other = spawn(8);
+        REQUIRE(first.size() == 6);
+        bool differs = false;
+        for (size_t i = 0; i < first.size(); ++i) {
+            CHECK(first[i].first.x == second[i].first.x);
+            CHECK(first[i].first.y == second[i].first.y);
+            CHECK(first[i].second == second[i].second);
+            differs = differs || first[i].first.x != other[i].first.x || first[i].first.y != other[i].first.y;
+        }
+        CHECK(differs);
+    }
@@ -0,0 +1,85 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/sessions_gate.h"
+
+#include <boost/asio/io_context.hpp>
+
+#include <string>
+#include <vector>
+
+using app::SessionsGate;
+
+TEST_CASE("Readers share the gate, a writer waits for them", "[SessionsGate]") {
+    boost::asio::io_context ioc;
+    SessionsGate gate;
+    std::vector<std::string> log;
+    std::vector<SessionsGate::Pass> passes;
+
+    gate.AsyncShared(ioc.get_executor(), [&](SessionsGate::Pass pass) {
+        log.push_back("reader 1");
+        passes.push_back(std::move(pass));
+    });
+    gate.AsyncShared(ioc.get_executor(), [&](SessionsGate::Pass pass) {
+        log.push_back("reader 2");
+        passes.push_back(std::move(pass));
+    });
+    gate.AsyncExclusive(ioc.get_executor(), [&](SessionsGate::Pass pass) {
+        CHECK(pass.IsExclusive());
+        log.push_back("writer");
+    });
+    ioc.run();
+    ioc.restart();
+    CHECK(log == std::vector<std::string>{"reader 1", "reader 2"});
+
+    passes.front().Release();
+    ioc.run();
+    ioc.restart();
+    CHECK(log.size() == 2);
+
+    passes.back().Release();
+    ioc.run();
+    CHECK(log == std::vector<std::string>{"reader 1", "reader 2", "writer"});
+}
+
+TEST_CASE("A waiting writer is not overtaken by new readers", "[SessionsGate]") {
+    boost::asio::io_context ioc;
+    SessionsGate gate;
+    std::vector<std::string> log;
+
+    auto reader = gate.LockShared();
+    REQUIRE(reader);
+    gate.AsyncExclusive(ioc.get_executor(), [&](SessionsGate::Pass) {
+        log.push_back("writer");
+    });
+    gate.AsyncShared(ioc.get_executor(), [&](SessionsGate::Pass) {
+        log.push_back("reader");
+    });
+    ioc.run();
+    ioc.restart();
+    CHECK(log.empty());
+
+    reader.Release();
+    ioc.run();
+    CHECK(log == std::vector<std::string>{"writer", "reader"});
+}
+
+TEST_CASE("Close cancels waiters and refuses new ones", "[SessionsGate]") {
+    boost::asio::io_context ioc;
+    SessionsGate gate;
+    bool called = false;
+
+    auto writer = gate.LockExclusive();
+    REQUIRE(writer.IsExclusive());
+    gate.AsyncShared(ioc.get_executor(), [&](SessionsGate::Pass) {
+        called = true;
+    });
+    gate.Close();
+    writer.Release();
+    gate.AsyncExclusive(ioc.get_executor(), [&](SessionsGate::Pass) {
+        called = true;
+    });
+    ioc.run();
+
+    CHECK_FALSE(called);
+    CHECK_FALSE(gate.LockShared());
+}
@@ -0,0 +1,135 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/model.h"
+#include "../src/state_binary.h"
+#include <memory>
+#include <string>
+
+using namespace model;
+using namespace std::chrono_literals;
+namespace state_binary = http_handler::state_binary;
+
+namespace {
+
+// Читает little-endian значения так же, как декодер на клиенте
+class Reader {
+public:
+    explicit Reader(const std::string& data) : data_(data) {}
+
+    template <typename T>
+    T Get() {
+        std::make_unsigned_t<T> bits = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            bits |= static_cast<std::make_unsigned_t<T>>(static_cast<unsigned char>(data_.at(pos_++))) << (8 * i);
+        }
+        return static_cast<T>(bits);
+    }
+
+    std::string GetBytes(size_t size) {
+        auto bytes = data_.substr(pos_, size);
+        pos_ += size;
+        return bytes;
+    }
+
+    size_t GetPos() const { return pos_; }
+
+private:
+    const std::string& data_;
+    size_t pos_ = 0;
+};
+
+std::shared_ptr<GameSession> MakeSession(Game& game) {
+    Map map(Map::Id{"map1"}, "TestMap", 3);
+    map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, 10});
+    game.AddMap(map);
+    return game.GetSession(Map::Id{"map1"});
+}
+
+}  // namespace
+
+TEST_CASE("Binary state carries dogs, bags and loot in fixed records", "[Binary]") {
+    Game game{false, std::make_shared<loot_gen::LootGenerator>(1000ms, 1.0)};
+    auto session = MakeSession(game);
+
+    const auto bim = session->AddDog("Bim", 3);
+    const auto bom = session->AddDog("Bom", 3);
+    {
+        auto dog = *session->GetDog(bim);
+        dog.SetPosition({1.234, -0.5});
+        dog.SetVelocity({-2.5, 0.0});
+        dog.SetDirection(Direction::WEST);
+        dog.AddPoints(7);
+        dog.GetBag().AddItem(10, 1);
+        dog.GetBag().AddItem(11, 2);
+    }
+    session->AddLoots(1);
+    session->FinishTick();
+
+    const std::string data = state_binary::BuildState(*session);
+    const auto& loot = session->GetLoots().GetValues()[0];
+    REQUIRE(data.size() == state_binary::STATE_HEADER_SIZE + 2 * state_binary::PLAYER_RECORD_SIZE
+                           + 2 * state_binary::BAG_ITEM_RECORD_SIZE + state_binary::LOOT_RECORD_SIZE);
+
+    Reader reader{data};
+    CHECK(reader.GetBytes(4) == "DGST");
+    CHECK(reader.Get<uint16_t>() == state_binary::VERSION);
+    reader.Get<uint16_t>();
+    CHECK(reader.Get<uint64_t>() == session->GetTick());
+    CHECK(reader.Get<uint32_t>() == 2);
+    CHECK(reader.Get<uint32_t>() == 1);
+    CHECK(reader.Get<uint32_t>() == 2);
+
+    CHECK(reader.Get<uint32_t>() == bim.id);
+    CHECK(reader.Get<int32_t>() == 123);
+    CHECK(reader.Get<int32_t>() == -50);
+    CHECK(reader.Get<int32_t>() == -250);
+    CHECK(reader.Get<int32_t>() == 0);
+    CHECK(reader.Get<int32_t>() == 7);
+    CHECK(reader.Get<uint16_t>() == 2);
+    CHECK(reader.Get<uint8_t>() == static_cast<uint8_t>(Direction::WEST));
+    reader.Get<uint8_t>();
+
+    CHECK(reader.Get<uint32_t>() == bom.id);
+    reader.GetBytes(state_binary::PLAYER_RECORD_SIZE - 8);
+    CHECK(reader.Get<uint16_t>() == 0);
+    reader.GetBytes(2);
+
+    CHECK(reader.Get<uint32_t>() == 10);
+    CHECK(reader.Get<uint32_t>() == 1);
+    CHECK(reader.Get<uint32_t>() == 11);
+    CHECK(reader.Get<uint32_t>() == 2);
+
+    CHECK(reader.Get<uint32_t>() == static_cast<uint32_t>(loot.GetId()));
+    CHECK(reader.Get<uint32_t>() == static_cast<uint32_t>(loot.GetType()));
+    CHECK(reader.Get<int32_t>() == state_binary::Quantize(loot.GetPosition().x));
+    CHECK(reader.Get<int32_t>() == state_binary::Quantize(loot.GetPosition().y));
+    CHECK(reader.GetPos() == data.size());
+}
+
+TEST_CASE("Binary players list names after fixed records", "[Binary]") {
+    Game game{false, std::make_shared<loot_gen::LootGenerator>(1000ms, 1.0)};
+    auto session = MakeSession(game);
+    const auto bim = session->AddDog("Bim", 3);
+    const auto rex = session->AddDog("Рекс", 3);
+
+    const std::string data = state_binary::BuildPlayers(*session);
+    Reader reader{data};
+    CHECK(reader.GetBytes(4) == "DGPL");
+    CHECK(reader.Get<uint16_t>() == state_binary::VERSION);
+    reader.Get<uint16_t>();
+    REQUIRE(reader.Get<uint32_t>() == 2);
+    CHECK(reader.Get<uint32_t>() == bim.id);
+    CHECK(reader.Get<uint32_t>() == 3);
+    CHECK(reader.Get<uint32_t>() == rex.id);
+    CHECK(reader.Get<uint32_t>() == std::string("Рекс").size());
+    CHECK(reader.GetBytes(3) == "Bim");
+    CHECK(reader.GetBytes(std::string("Рекс").size()) == "Рекс");
+    CHECK(reader.GetPos() == data.size());
+}
+
+TEST_CASE("Binary positions saturate instead of wrapping", "[Binary]") {
+    CHECK(state_binary::Quantize(0.004) == 0);
+    CHECK(state_binary::Quantize(-0.006) == -1);
+    CHECK(state_binary::Quantize(1e12) == std::numeric_limits<int32_t>::max());
+    CHECK(state_binary::Quantize(-1e12) == std::numeric_limits<int32_t>::min());
+}
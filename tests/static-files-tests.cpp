@@ -0,0 +1,261 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/request_handler.h"
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+using namespace http_handler;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Временный www-root, удаляется вместе с содержимым
+class TempRoot {
+public:
+    TempRoot() {
+        std::random_device device;
+        path_ = fs::temp_directory_path() / ("static-files-tests-" + std::to_string(device()));
+        fs::create_directories(path_);
+    }
+
+    TempRoot(const TempRoot&) = delete;
+    TempRoot& operator=(const TempRoot&) = delete;
+
+    ~TempRoot() {
+        std::error_code ec;
+        fs::remove_all(path_, ec);
+    }
+
+    void AddFile(const fs::path& relative, const std::string& content) const {
+        const auto path = path_ / relative;
+        fs::create_directories(path.parent_path());
+        std::ofstream{path, std::ios::binary} << content;
+    }
+
+    const fs::path& GetPath() const noexcept {
+        return path_;
+    }
+
+private:
+    fs::path path_;
+};
+
+StringRequest MakeGet(std::string_view target) {
+    StringRequest req{http::verb::get, target, 11};
+    req.keep_alive(true);
+    return req;
+}
+
+// Тело ответа из кэша или пустая строка, если ответ другого вида
+std::string GetCachedBody(const StaticFileResponse& response) {
+    const auto* cached = std::get_if<SharedBufferResponse>(&response);
+    return cached && cached->body() ? *cached->body() : std::string{};
+}
+
+unsigned GetStatus(const StaticFileResponse& response) {
+    return std::visit([](const auto& res) { return res.result_int(); }, response);
+}
+
+std::string GetHeader(const StaticFileResponse& response, http::field field) {
+    return std::visit([field](const auto& res) { return std::string{res[field]}; }, response);
+}
+
+// Текст, который gzip заметно сжимает
+std::string MakeScript() {
+    std::string script;
+    for (int i = 0; i < 200; ++i) {
+        script += "console.log('line " + std::to_string(i % 10) + "');\n";
+    }
+    return script;
+}
+
+}  // namespace
+
+TEST_CASE("Directories are served by their index.html", "[StaticFiles]") {
+    TempRoot root;
+    root.AddFile("index.html", "<html>root</html>");
+    root.AddFile("docs/index.html", "<html>docs</html>");
+    root.AddFile("docs/page.html", "<html>page</html>");
+    const StaticFiles files{root.GetPath()};
+
+    const auto* root_index = files.Find("/index.html");
+    REQUIRE(root_index);
+    CHECK(files.Find("/") == root_index);
+    CHECK(*root_index->body == "<html>root</html>");
+    CHECK(root_index->content_type == ContentType::TEXT_HTML);
+
+    const auto* docs_index = files.Find("/docs/index.html");
+    REQUIRE(docs_index);
+    CHECK(files.Find("/docs") == docs_index);
+    CHECK(files.Find("/docs/") == docs_index);
+    CHECK(files.Find("/docs/page.html") != docs_index);
+    CHECK_FALSE(files.Find("/missing.html"));
+    CHECK_FALSE(files.Find("/docs/page.html/"));
+}
+
+TEST_CASE("Paths above the root are rejected", "[StaticFiles]") {
+    CHECK(EscapesRoot("/.."));
+    CHECK(EscapesRoot("/../secret.txt"));
+    CHECK(EscapesRoot("/docs/../../secret.txt"));
+    CHECK(EscapesRoot("/./../secret.txt"));
+    CHECK_FALSE(EscapesRoot("/"));
+    CHECK_FALSE(EscapesRoot("/docs/../index.html"));
+    CHECK_FALSE(EscapesRoot("/docs/./page.html"));
+    CHECK_FALSE(EscapesRoot("/..hidden/file"));
+
+    TempRoot root;
+    root.AddFile("www/index.html", "<html>root</html>");
+    root.AddFile("secret.txt", "secret");
+    const StaticFiles files{root.GetPath() / "www"};
+
+    for (const auto* target : {"/../secret.txt", "/%2e%2e/secret.txt", "/a/../../secret.txt"}) {
+        INFO(target);
+        const auto response = HandleStaticFileRequest(files, MakeGet(target));
+        CHECK(GetStatus(response) == 400);
+        CHECK(GetCachedBody(response).empty());
+    }
+    // Выход за каталог внутри корня допустим, путь нормализуется
+    const auto response = HandleStaticFileRequest(files, MakeGet("/docs/../index.html"));
+    CHECK(GetStatus(response) == 200);
+    CHECK(GetCachedBody(response) == "<html>root</html>");
+}
+
+TEST_CASE("Symbolic links are served only when they stay inside the root", "[StaticFiles]") {
+    TempRoot root;
+    root.AddFile("www/index.html", "<html>root</html>");
+    root.AddFile("secret.txt", "secret");
+    const auto www = root.GetPath() / "www";
+    fs::create_symlink(root.GetPath() / "secret.txt", www / "leak.txt");
+    fs::create_symlink("../secret.txt", www / "relative-leak.txt");
+    fs::create_directory_symlink(root.GetPath(), www / "up");
+    fs::create_symlink(www / "index.html", www / "alias.html");
+    fs::create_symlink(www / "missing.html", www / "dangling.html");
+    const StaticFiles files{www};
+
+    CHECK_FALSE(files.Find("/leak.txt"));
+    CHECK_FALSE(files.Find("/relative-leak.txt"));
+    CHECK_FALSE(files.Find("/up/secret.txt"));
+    CHECK_FALSE(files.Find("/dangling.html"));
+    CHECK(GetStatus(HandleStaticFileRequest(files, MakeGet("/leak.txt"))) == 404);
+
+    const auto* alias = files.Find("/alias.html");
+    REQUIRE(alias);
+    CHECK(*alias->body == "<html>root</html>");
+    CHECK(alias->content_type == ContentType::TEXT_HTML);
+}
+
+TEST_CASE("Query string is not part of the file path", "[StaticFiles]") {
+    TempRoot root;
+    root.AddFile("index.html", "<html>root</html>");
+    root.AddFile("js/app.js", "let x = 1;");
+    root.AddFile("my file.txt", "spaced");
+    const StaticFiles files{root.GetPath()};
+
+    auto response = HandleStaticFileRequest(files, MakeGet("/js/app.js?v=3&cache=no"));
+    CHECK(GetStatus(response) == 200);
+    CHECK(GetCachedBody(response) == "let x = 1;");
+    CHECK(GetHeader(response, http::field::content_type) == ContentType::TEXT_JS);
+
+    response = HandleStaticFileRequest(files, MakeGet("/?from=link"));
+    CHECK(GetCachedBody(response) == "<html>root</html>");
+
+    response = HandleStaticFileRequest(files, MakeGet("/my%20file.txt?x=%2F"));
+    CHECK(GetCachedBody(response) == "spaced");
+
+    response = HandleStaticFileRequest(files, MakeGet("/js/app.js.map?v=3"));
+    CHECK(GetStatus(response) == 404);
+}
+
+TEST_CASE("Compressible files are sent gzipped to clients that accept it", "[StaticFiles]") {
+    TempRoot root;
+    const std::string script = MakeScript();
+    root.AddFile("app.js", script);
+    root.AddFile("image.png", script);
+    const StaticFiles files{root.GetPath()};
+
+    const auto* file = files.Find("/app.js");
+    REQUIRE(file);
+    REQUIRE(file->gzip_body);
+    CHECK(file->gzip_body->size() < script.size());
+    CHECK(file->gzip_etag != file->etag);
+    // Картинки не сжимаются повторно
+    REQUIRE(files.Find("/image.png"));
+    CHECK_FALSE(files.Find("/image.png")->gzip_body);
+
+    auto plain = HandleStaticFileRequest(files, MakeGet("/app.js"));
+    CHECK(GetCachedBody(plain) == script);
+    CHECK(GetHeader(plain, http::field::content_encoding).empty());
+    CHECK(GetHeader(plain, http::field::etag) == file->etag);
+    CHECK(GetHeader(plain, http::field::vary) == "Accept-Encoding");
+
+    auto req = MakeGet("/app.js");
+    req.set(http::field::accept_encoding, "br, gzip;q=0.8");
+    auto gzipped = HandleStaticFileRequest(files, req);
+    CHECK(GetCachedBody(gzipped) == *file->gzip_body);
+    CHECK(GetHeader(gzipped, http::field::content_encoding) == "gzip");
+    CHECK(GetHeader(gzipped, http::field::etag) == file->gzip_etag);
+
+    req.set(http::field::accept_encoding, "gzip;q=0");
+    CHECK(GetCachedBody(HandleStaticFileRequest(files, req)) == script);
+}
+
+TEST_CASE("Unchanged files are answered with 304", "[StaticFiles]") {
+    TempRoot root;
+    root.AddFile("app.js", MakeScript());
+    const StaticFiles files{root.GetPath()};
+    const auto* file = files.Find("/app.js");
+    REQUIRE(file);
+
+    auto req = MakeGet("/app.js");
+    req.set(http::field::if_none_match, file->etag);
+    auto response = HandleStaticFileRequest(files, req);
+    CHECK(GetStatus(response) == 304);
+    CHECK(GetCachedBody(response).empty());
+    CHECK(GetHeader(response, http::field::etag) == file->etag);
+
+    // Тег несжатой версии не подходит к сжатой, и наоборот
+    req.set(http::field::accept_encoding, "gzip");
+    CHECK(GetStatus(HandleStaticFileRequest(files, req)) == 200);
+    req.set(http::field::if_none_match, "\"other\", " + file->gzip_etag);
+    CHECK(GetStatus(HandleStaticFileRequest(files, req)) == 304);
+
+    // If-Modified-Since проверяется, только если нет If-None-Match
+    auto by_date = MakeGet("/app.js");
+    by_date.set(http::field::if_modified_since, file->last_modified);
+    CHECK(GetStatus(HandleStaticFileRequest(files, by_date)) == 304);
+    by_date.set(http::field::if_none_match, "\"other\"");
+    CHECK(GetStatus(HandleStaticFileRequest(files, by_date)) == 200);
+}
+
+TEST_CASE("Files above the threshold are sent from disk with ranges", "[StaticFiles]") {
+    TempRoot root;
+    root.AddFile("small.txt", "small");
+    root.AddFile("big.bin", std::string(100, 'x') + "0123456789");
+    const StaticFiles files{root.GetPath(), 64};
+
+    REQUIRE(files.Find("/small.txt"));
+    CHECK(files.Find("/small.txt")->body);
+    const auto* big = files.Find("/big.bin");
+    REQUIRE(big);
+    CHECK_FALSE(big->body);
+    CHECK(big->size == 110);
+
+    auto response = HandleStaticFileRequest(files, MakeGet("/big.bin"));
+    REQUIRE(std::holds_alternative<FileRangeResponse>(response));
+    CHECK(GetStatus(response) == 200);
+    CHECK(std::get<FileRangeResponse>(response).body().size == 110);
+
+    auto req = MakeGet("/big.bin");
+    req.set(http::field::range, "bytes=100-");
+    response = HandleStaticFileRequest(files, req);
+    REQUIRE(std::holds_alternative<FileRangeResponse>(response));
+    CHECK(GetStatus(response) == 206);
+    CHECK(GetHeader(response, http::field::content_range) == "bytes 100-109/110");
+    CHECK(std::get<FileRangeResponse>(response).body().offset == 100);
+
+    req.set(http::field::if_none_match, big->etag);
+    CHECK(GetStatus(HandleStaticFileRequest(files, req)) == 304);
+}